@@ -3,7 +3,9 @@
 
 The output format matches the benchmark input: one directed edge per line as
 "from to weight" with zero-based node ids. Lines that start with # are treated as
-comments by the benchmark and are used here for metadata.
+comments by the benchmark and are used here for metadata. The first line is the
+"# sssp-graph" header the loader uses to presize the graph; edges are written
+grouped by source so it can fill the CSR in a single pass.
 """
 
 import argparse
@@ -27,13 +29,26 @@ def _validate_args(nodes: int, edges: int, max_weight: int) -> None:
         raise ValueError("max-weight must be positive")
 
 
-def generate_edges(nodes: int, edges: int, max_weight: int, rng: random.Random) -> Iterable[Edge]:
+def draw_weight(max_weight: int, distribution: str, rng: random.Random) -> int:
+    """Draw one weight in [1, max_weight].
+
+    "log-uniform" picks the bit length uniformly first, so weights spread over
+    every magnitude up to max_weight instead of clustering near the top.
+    """
+    if distribution == "log-uniform":
+        bits = rng.randint(1, max_weight.bit_length())
+        return min(max_weight, rng.randint(1 << (bits - 1), (1 << bits) - 1))
+    return rng.randint(1, max_weight)
+
+
+def generate_edges(nodes: int, edges: int, max_weight: int, rng: random.Random,
+                   distribution: str = "uniform") -> Iterable[Edge]:
     """Generate a directed graph with at least a simple backbone path."""
     used = set()
     # Create a simple path to guarantee reachability from node 0.
     for u in range(nodes - 1):
         v = u + 1
-        w = rng.randint(1, max_weight)
+        w = draw_weight(max_weight, distribution, rng)
         used.add((u, v))
         yield (u, v, w)
 
@@ -46,29 +61,43 @@ def generate_edges(nodes: int, edges: int, max_weight: int, rng: random.Random)
         key = (u, v)
         if key in used:
             continue
-        w = rng.randint(1, max_weight)
+        w = draw_weight(max_weight, distribution, rng)
         used.add(key)
         yield (u, v, w)
         remaining -= 1
 
 
+def metadata_header(nodes: int, edges: Iterable[Edge], sorted_by_source: bool) -> str:
+    """Return the "# sssp-graph" header line describing `edges`."""
+    edge_list = list(edges)
+    max_weight = max((w for _, _, w in edge_list), default=0)
+    return (f"# sssp-graph nodes={nodes} edges={len(edge_list)} max_weight={max_weight} "
+            f"sorted_by_source={int(sorted_by_source)}\n")
+
+
 def main(argv: Iterable[str]) -> int:
     parser = argparse.ArgumentParser(description="Generate a large random graph file for the SSSP benchmark.")
     parser.add_argument("output", type=pathlib.Path, help="Path to write the generated graph (text file)")
     parser.add_argument("--nodes", type=int, default=50000, help="Number of nodes to generate (default: 50000)")
     parser.add_argument("--edges", type=int, default=300000, help="Number of directed edges (default: 300000)")
     parser.add_argument("--max-weight", type=int, default=1000, help="Maximum edge weight (default: 1000)")
+    parser.add_argument("--weights", choices=("uniform", "log-uniform"), default="uniform",
+                        help="Weight distribution (default: uniform); log-uniform with a large --max-weight "
+                             "spreads distances over the 64-bit key range")
     parser.add_argument("--seed", type=int, default=42, help="Random seed for reproducibility (default: 42)")
     args = parser.parse_args(argv)
 
     _validate_args(args.nodes, args.edges, args.max_weight)
 
     rng = random.Random(args.seed)
-    edges = list(generate_edges(args.nodes, args.edges, args.max_weight, rng))
+    edges = list(generate_edges(args.nodes, args.edges, args.max_weight, rng, args.weights))
+    # Stable, so each source keeps its edges in generation order.
+    edges.sort(key=lambda edge: edge[0])
 
     args.output.parent.mkdir(parents=True, exist_ok=True)
     with args.output.open("w", encoding="ascii") as fh:
-        fh.write(f"# Random graph generated with nodes={args.nodes}, edges={args.edges}, max_weight={args.max_weight}, seed={args.seed}\n")
+        fh.write(metadata_header(args.nodes, edges, sorted_by_source=True))
+        fh.write(f"# Random graph generated with nodes={args.nodes}, edges={args.edges}, max_weight={args.max_weight}, weights={args.weights}, seed={args.seed}\n")
         for u, v, w in edges:
             fh.write(f"{u} {v} {w}\n")
 
@@ -1,198 +1,6367 @@
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <numeric>
+#include <optional>
 #include <queue>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <type_traits>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if defined(SSSP_WITH_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined(SSSP_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+#if defined(__unix__)
+#include <pthread.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+constexpr std::size_t kCacheLineBytes = 64;
+
 struct Edge {
     int to;
     std::uint64_t weight;
 };
 
-using Graph = std::vector<std::vector<Edge>>;
+// Out-edges of one vertex, a contiguous slice of the CSR edge array.
+struct EdgeRange {
+    const Edge* first;
+    const Edge* last;
 
-struct GraphLoadResult {
-    Graph graph;
-    int node_count = 0;
+    const Edge* begin() const { return first; }
+    const Edge* end() const { return last; }
+    std::size_t size() const { return static_cast<std::size_t>(last - first); }
+    bool empty() const { return first == last; }
 };
 
-GraphLoadResult read_graph_from_file(const std::string& path) {
-    std::ifstream in(path);
-    if (!in) {
-        throw std::runtime_error("Failed to open input file: " + path);
+// Compressed sparse row graph: the out-edges of u are
+// edges[offsets[u] .. offsets[u + 1]). The arrays are either owned or
+// borrowed from a read-only mapping that `keep_alive` holds open.
+class Graph {
+public:
+    Graph() = default;
+
+    Graph(std::vector<std::uint64_t> offsets, std::vector<Edge> edges)
+        : offset_storage(std::move(offsets)), edge_storage(std::move(edges)) {
+        offsets_ptr = offset_storage.data();
+        edges_ptr = edge_storage.data();
+        nodes = offset_storage.empty() ? 0 : offset_storage.size() - 1;
     }
 
-    std::vector<std::tuple<int, int, std::uint64_t>> edges;
-    std::string line;
-    int max_node = -1;
+    static Graph borrowed(const std::uint64_t* offsets, const Edge* edges,
+        std::size_t node_count, std::shared_ptr<const void> keep_alive) {
+        Graph graph;
+        graph.offsets_ptr = offsets;
+        graph.edges_ptr = edges;
+        graph.nodes = node_count;
+        graph.mapping = std::move(keep_alive);
+        return graph;
+    }
 
-    while (std::getline(in, line)) {
-        if (line.empty() || line[0] == '#') {
-            continue;
+    Graph(Graph&&) = default;
+    Graph& operator=(Graph&&) = default;
+    Graph(const Graph&) = delete;
+    Graph& operator=(const Graph&) = delete;
+
+    std::size_t size() const { return nodes; }
+    bool empty() const { return nodes == 0; }
+    std::size_t edge_count() const { return nodes == 0 ? 0 : offsets_ptr[nodes]; }
+
+    EdgeRange operator[](std::size_t u) const {
+        return { edges_ptr + offsets_ptr[u], edges_ptr + offsets_ptr[u + 1] };
+    }
+
+    const std::uint64_t* offsets() const { return offsets_ptr; }
+    const Edge* edges() const { return edges_ptr; }
+
+    bool is_borrowed() const { return mapping != nullptr; }
+
+    // Writable edge array; only owned graphs can be modified.
+    Edge* mutable_edges() {
+        if (is_borrowed()) {
+            throw std::runtime_error("Graph is attached read-only and cannot be modified");
         }
-        std::istringstream iss(line);
-        int from, to;
-        long long w_input;
-        if (!(iss >> from >> to >> w_input)) {
-            throw std::runtime_error("Invalid line in input file: " + line);
+        return edge_storage.data();
+    }
+
+private:
+    std::vector<std::uint64_t> offset_storage;
+    std::vector<Edge> edge_storage;
+    std::shared_ptr<const void> mapping;
+    const std::uint64_t* offsets_ptr = nullptr;
+    const Edge* edges_ptr = nullptr;
+    std::size_t nodes = 0;
+};
+
+// 8-byte edge for graphs whose vertex ids, weights and edge count all fit
+// in 32 bits; half the bytes of Edge per relaxation.
+struct NarrowEdge {
+    std::uint32_t to;
+    std::uint32_t weight;
+};
+
+struct NarrowEdgeRange {
+    const NarrowEdge* first;
+    const NarrowEdge* last;
+
+    const NarrowEdge* begin() const { return first; }
+    const NarrowEdge* end() const { return last; }
+    std::size_t size() const { return static_cast<std::size_t>(last - first); }
+    bool empty() const { return first == last; }
+};
+
+// CSR with 32-bit offsets and NarrowEdge rows. Engines templated on the
+// graph type run on it unchanged.
+class NarrowGraph {
+public:
+    NarrowGraph() = default;
+    NarrowGraph(std::vector<std::uint32_t> offsets, std::vector<NarrowEdge> edges)
+        : offsets(std::move(offsets)), edges(std::move(edges)) {}
+
+    std::size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    bool empty() const { return size() == 0; }
+    std::size_t edge_count() const { return edges.size(); }
+
+    NarrowEdgeRange operator[](std::size_t u) const {
+        return { edges.data() + offsets[u], edges.data() + offsets[u + 1] };
+    }
+
+    std::size_t bytes() const {
+        return offsets.size() * sizeof(std::uint32_t) + edges.size() * sizeof(NarrowEdge);
+    }
+
+private:
+    std::vector<std::uint32_t> offsets;
+    std::vector<NarrowEdge> edges;
+};
+
+// Appends `value` as a little-endian base-128 varint.
+void put_varint(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t get_varint(const std::uint8_t*& p) {
+    std::uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        const std::uint8_t byte = *p++;
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (byte < 0x80) {
+            return value;
+        }
+    }
+}
+
+// One row of a CompressedGraph. Iteration decodes edges on the fly.
+class CompressedRow {
+public:
+    class iterator {
+    public:
+        iterator(const std::uint8_t* pos, const std::uint8_t* end) : pos(pos), next(pos), end(end) { decode(); }
+
+        const Edge& operator*() const { return current; }
+        const Edge* operator->() const { return &current; }
+        iterator& operator++() {
+            pos = next;
+            decode();
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return pos == other.pos; }
+        bool operator!=(const iterator& other) const { return pos != other.pos; }
+
+    private:
+        const std::uint8_t* pos;
+        const std::uint8_t* next;
+        const std::uint8_t* end;
+        Edge current{ 0, 0 };
+
+        void decode() {
+            if (next < end) {
+                current.to += static_cast<int>(get_varint(next));
+                current.weight = get_varint(next);
+            }
+        }
+    };
+
+    CompressedRow(const std::uint8_t* first, const std::uint8_t* last) : first(first), last(last) {}
+
+    iterator begin() const { return { first, last }; }
+    iterator end() const { return { last, last }; }
+    bool empty() const { return first == last; }
+
+private:
+    const std::uint8_t* first;
+    const std::uint8_t* last;
+};
+
+// Rows stored as varint byte streams: neighbours in ascending order as gaps
+// from the previous one (the first from 0), each followed by its weight.
+// Smallest of the in-memory representations, at the cost of decoding every
+// edge.
+class CompressedGraph {
+public:
+    CompressedGraph() = default;
+
+    // Encodes any graph whose rows yield `to`/`weight` edges.
+    template <typename G>
+    static CompressedGraph encode(const G& graph) {
+        CompressedGraph result;
+        result.offsets.reserve(graph.size() + 1);
+        result.offsets.push_back(0);
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> row;
+        for (std::size_t u = 0; u < graph.size(); ++u) {
+            row.clear();
+            for (const auto& e : graph[u]) {
+                row.emplace_back(e.to, e.weight);
+            }
+            std::sort(row.begin(), row.end());
+            std::uint64_t previous = 0;
+            for (const auto& [to, weight] : row) {
+                put_varint(result.stream, to - previous);
+                put_varint(result.stream, weight);
+                previous = to;
+            }
+            result.offsets.push_back(result.stream.size());
+            result.edges += row.size();
+        }
+        result.stream.shrink_to_fit();
+        return result;
+    }
+
+    std::size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    bool empty() const { return size() == 0; }
+    std::size_t edge_count() const { return edges; }
+
+    CompressedRow operator[](std::size_t u) const {
+        return { stream.data() + offsets[u], stream.data() + offsets[u + 1] };
+    }
+
+    std::size_t bytes() const { return offsets.size() * sizeof(std::uint64_t) + stream.size(); }
+
+private:
+    std::vector<std::uint64_t> offsets;
+    std::vector<std::uint8_t> stream;
+    std::size_t edges = 0;
+};
+
+// Distinct edge weights in ascending order, or nullopt once there are more
+// than `limit` of them.
+template <typename G>
+std::optional<std::vector<std::uint64_t>> weight_alphabet(const G& graph, std::size_t limit) {
+    std::unordered_set<std::uint64_t> seen;
+    for (std::size_t u = 0; u < graph.size(); ++u) {
+        for (const auto& e : graph[u]) {
+            if (seen.insert(e.weight).second && seen.size() > limit) {
+                return std::nullopt;
+            }
         }
-        if (from < 0 || to < 0) {
-            throw std::runtime_error("Node ids must be non-negative: " + line);
+    }
+    std::vector<std::uint64_t> palette(seen.begin(), seen.end());
+    std::sort(palette.begin(), palette.end());
+    return palette;
+}
+
+// One row of a PaletteGraph; dereferencing looks the weight up in the palette.
+template <typename Index>
+class PaletteRow {
+public:
+    class iterator {
+    public:
+        iterator(const int* to, const Index* index, const std::uint64_t* palette)
+            : to(to), index(index), palette(palette) {}
+
+        Edge operator*() const { return { *to, palette[*index] }; }
+        iterator& operator++() {
+            ++to;
+            ++index;
+            return *this;
         }
-        if (w_input < 0) {
-            throw std::runtime_error("Edge weights must be non-negative: " + line);
+        bool operator==(const iterator& other) const { return to == other.to; }
+        bool operator!=(const iterator& other) const { return to != other.to; }
+
+    private:
+        const int* to;
+        const Index* index;
+        const std::uint64_t* palette;
+    };
+
+    PaletteRow(const int* to, const Index* index, std::size_t count, const std::uint64_t* palette)
+        : to(to), index(index), count(count), palette(palette) {}
+
+    iterator begin() const { return { to, index, palette }; }
+    iterator end() const { return { to + count, index + count, palette }; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    const int* to;
+    const Index* index;
+    std::size_t count;
+    const std::uint64_t* palette;
+};
+
+// CSR for graphs with a small weight alphabet: targets and 8- or 16-bit
+// palette indices in separate arrays, so an edge takes 5 or 6 bytes instead
+// of the 16 of Edge. Palette order follows weight order, so rows sorted by
+// weight stay sorted.
+template <typename Index>
+class PaletteGraph {
+public:
+    static constexpr std::size_t kMaxWeights = std::size_t{ 1 } << (8 * sizeof(Index));
+
+    // Encodes any graph whose rows yield `to`/`weight` edges; `palette`
+    // must hold every weight, sorted, and at most kMaxWeights of them.
+    template <typename G>
+    static PaletteGraph encode(const G& graph, std::vector<std::uint64_t> palette) {
+        PaletteGraph result;
+        result.palette = std::move(palette);
+        result.offsets.reserve(graph.size() + 1);
+        result.offsets.push_back(0);
+        for (std::size_t u = 0; u < graph.size(); ++u) {
+            for (const auto& e : graph[u]) {
+                result.targets.push_back(e.to);
+                result.indices.push_back(static_cast<Index>(
+                    std::lower_bound(result.palette.begin(), result.palette.end(), e.weight)
+                    - result.palette.begin()));
+            }
+            result.offsets.push_back(result.targets.size());
         }
-        std::uint64_t w = static_cast<std::uint64_t>(w_input);
-        edges.emplace_back(from, to, w);
-        max_node = std::max({ max_node, from, to });
+        return result;
     }
 
-    if (max_node < 0) {
-        return {};
+    std::size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    bool empty() const { return size() == 0; }
+    std::size_t edge_count() const { return targets.size(); }
+    std::size_t distinct_weights() const { return palette.size(); }
+
+    PaletteRow<Index> operator[](std::size_t u) const {
+        return { targets.data() + offsets[u], indices.data() + offsets[u],
+            static_cast<std::size_t>(offsets[u + 1] - offsets[u]), palette.data() };
     }
 
-    Graph graph(static_cast<std::size_t>(max_node + 1));
-    for (const auto& e : edges) {
-        int from, to;
-        std::uint64_t w;
-        std::tie(from, to, w) = e;
-        graph[static_cast<std::size_t>(from)].push_back({ to, w });
+    std::size_t bytes() const {
+        return offsets.size() * sizeof(std::uint64_t) + targets.size() * sizeof(int)
+            + indices.size() * sizeof(Index) + palette.size() * sizeof(std::uint64_t);
     }
 
-    return { std::move(graph), max_node + 1 };
+private:
+    std::vector<std::uint64_t> offsets;
+    std::vector<int> targets;
+    std::vector<Index> indices;
+    std::vector<std::uint64_t> palette;
+};
+
+// Runs fn(i) for every i in [0, count) on up to `threads` threads and
+// rethrows the first exception.
+template <typename Fn>
+void parallel_for(std::size_t count, int threads, Fn&& fn) {
+    const std::size_t workers = std::min<std::size_t>(count, static_cast<std::size_t>(std::max(1, threads)));
+    if (workers <= 1) {
+        for (std::size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+    std::atomic<std::size_t> next{ 0 };
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto run = [&] {
+        for (std::size_t i = next++; i < count; i = next++) {
+            try {
+                fn(i);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = count;
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (std::size_t t = 1; t < workers; ++t) {
+        pool.emplace_back(run);
+    }
+    run();
+    for (auto& t : pool) {
+        t.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
 }
 
-// Dijkstra using binary heap priority_queue.
-std::vector<std::uint64_t> dijkstra(const Graph& graph, int source) {
-    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
-    std::vector<std::uint64_t> dist(graph.size(), INF);
-    dist[source] = 0;
+struct LoadOptions {
+    // "auto" (io_uring when the kernel allows it), "uring" or "pread".
+    std::string io_backend = "auto";
+    // Threads parsing completed chunks; 0 = hardware threads.
+    int parser_threads = 0;
+    std::size_t chunk_bytes = std::size_t{ 4 } << 20;
+    // Reads kept in flight ahead of the parser.
+    std::size_t read_depth = 8;
+    // "auto" (extension, then contents), "edge", "dimacs", "snap", "mtx" or "metis".
+    std::string format = "auto";
+    // MatrixMarket real values are multiplied by this and rounded.
+    double weight_scale = 1.0;
+    // Vertex coordinates to load with the graph (DIMACS .co); empty = none.
+    std::string coords_path;
+    // Resident-memory budget in bytes (0 = none); picks the graph layout.
+    std::uint64_t mem_limit = 0;
+    // Let the budget pick layouts other engines cannot read (narrow CSR,
+    // compressed). Off for modes that need a CSR Graph.
+    bool compact_representations = true;
+    // Order rows by weight while building layouts that are read-only once
+    // built (out-of-core CSR).
+    bool sort_rows = false;
+};
 
-    using P = std::pair<std::uint64_t, int>;
-    std::priority_queue<P, std::vector<P>, std::greater<P>> pq;
-    pq.push({ 0, source });
+// How a graph was loaded, for the load summary line.
+struct LoadReport {
+    std::string format;
+    std::string io_backend;
+    int parser_threads = 0;
+    // Bytes on disk, and after decompression.
+    std::uint64_t bytes = 0;
+    std::uint64_t decoded_bytes = 0;
+    double total_ms = 0.0;
+    // Time the parser pipeline spent waiting for input (disk or decompression).
+    double io_wait_ms = 0.0;
+};
 
-    while (!pq.empty()) {
-        auto [d, u] = pq.top();
-        pq.pop();
-        if (d != dist[u]) {
-            continue;
+// Position of a vertex, as read from a coordinate file.
+struct Coordinate {
+    double x = 0.0;
+    double y = 0.0;
+};
+
+// Graph layouts a memory budget can choose from, fastest first.
+enum class Representation { csr, narrow_csr, adjacency_lists, compressed, out_of_core };
+
+// Projected footprint of one layout for the parsed graph.
+struct RepresentationEstimate {
+    Representation kind;
+    // Narrow CSR needs 32-bit ids, weights and edge count.
+    bool applicable = true;
+    std::uint64_t graph_bytes = 0;
+    // Resident peak over building the layout and running queries on it.
+    std::uint64_t peak_bytes = 0;
+};
+
+// What --mem-limit decided and why.
+struct MemoryPlan {
+    std::uint64_t limit = 0;
+    // Resident before building, and the parsed edges among it; the peak
+    // while reading (buffers, partial blocks) is a floor for every layout.
+    std::uint64_t base_bytes = 0;
+    std::uint64_t parse_peak_bytes = 0;
+    std::uint64_t parsed_bytes = 0;
+    // dist, settled bits, heap and result vectors for the benchmark.
+    std::uint64_t working_bytes = 0;
+    std::vector<RepresentationEstimate> estimates;
+    // Edge count and weights fit the 32-bit fields of narrow CSR.
+    bool narrow_fits = false;
+    Representation chosen = Representation::csr;
+    std::uint64_t projected_peak = 0;
+    // Size of the layout once built.
+    std::uint64_t actual_graph_bytes = 0;
+};
+
+struct GraphLoadResult {
+    // Empty when the memory budget picked a compact layout below.
+    Graph graph;
+    int node_count = 0;
+    // Every adjacency row is ordered by ascending weight.
+    bool rows_sorted_by_weight = false;
+    LoadReport report;
+    // One entry per vertex when LoadOptions::coords_path is set.
+    std::vector<Coordinate> coordinates;
+    Representation representation = Representation::csr;
+    NarrowGraph narrow;
+    CompressedGraph compressed;
+    std::optional<MemoryPlan> memory_plan;
+};
+
+struct ParsedEdge {
+    int from;
+    int to;
+    std::uint64_t weight;
+};
+
+// Edges parsed from one block of input lines, in input order.
+struct ParsedBlock {
+    std::vector<ParsedEdge> edges;
+    int max_node = -1;
+};
+
+// Builds the CSR in one sequential pass when the blocks, in file order, list
+// edges grouped by ascending source. Returns nullopt as soon as a source goes
+// backwards, so the caller can fall back to build_csr. A header's edge count
+// sizes the edge array; otherwise the blocks are counted first.
+std::optional<Graph> build_csr_grouped(std::size_t node_count, const std::vector<ParsedBlock>& blocks,
+    std::optional<std::uint64_t> declared_edges = std::nullopt) {
+    std::size_t total = 0;
+    if (declared_edges) {
+        total = static_cast<std::size_t>(*declared_edges);
+    }
+    else {
+        for (const auto& block : blocks) {
+            total += block.edges.size();
         }
-        for (const auto& edge : graph[u]) {
-            std::uint64_t nd = d + edge.weight;
-            if (nd < dist[edge.to]) {
-                dist[edge.to] = nd;
-                pq.push({ nd, edge.to });
+    }
+    std::vector<std::uint64_t> offsets(node_count + 1);
+    std::vector<Edge> csr;
+    csr.reserve(total);
+    std::size_t next_row = 0;
+    for (const auto& block : blocks) {
+        for (const auto& e : block.edges) {
+            const auto from = static_cast<std::size_t>(e.from);
+            if (from + 1 < next_row) {
+                return std::nullopt;
             }
+            while (next_row <= from) {
+                offsets[next_row++] = csr.size();
+            }
+            csr.push_back({ e.to, e.weight });
         }
     }
+    while (next_row <= node_count) {
+        offsets[next_row++] = csr.size();
+    }
+    return Graph(std::move(offsets), std::move(csr));
+}
 
-    return dist;
+// Row offsets of the parsed edges (a counting pass by source).
+template <typename Offset>
+std::vector<Offset> csr_offsets(std::size_t node_count, const std::vector<ParsedBlock>& blocks) {
+    std::vector<Offset> offsets(node_count + 1, 0);
+    for (const auto& block : blocks) {
+        for (const auto& e : block.edges) {
+            ++offsets[static_cast<std::size_t>(e.from) + 1];
+        }
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    return offsets;
 }
 
-// Radix heap implementation for 64-bit unsigned keys.
-class RadixHeap {
-public:
-    RadixHeap() : buckets(65), last(0), sz(0) {}
+// Scatters the parsed edges into their rows at `out`, keeping each row in
+// input order.
+template <typename Offset, typename EdgeType>
+void scatter_csr(const std::vector<Offset>& offsets, const std::vector<ParsedBlock>& blocks, EdgeType* out) {
+    std::vector<Offset> cursor(offsets.begin(), offsets.end() - 1);
+    for (const auto& block : blocks) {
+        for (const auto& e : block.edges) {
+            out[cursor[static_cast<std::size_t>(e.from)]++] = {
+                static_cast<decltype(EdgeType::to)>(e.to), static_cast<decltype(EdgeType::weight)>(e.weight) };
+        }
+    }
+}
 
-    bool empty() const { return sz == 0; }
-    std::size_t size() const { return sz; }
+// Orders every row by ascending weight (ties by target), in place.
+void sort_rows_by_weight(const std::uint64_t* offsets, Edge* edges, std::size_t node_count) {
+    for (std::size_t u = 0; u < node_count; ++u) {
+        std::sort(edges + offsets[u], edges + offsets[u + 1], [](const Edge& a, const Edge& b) {
+            return std::tie(a.weight, a.to) < std::tie(b.weight, b.to);
+        });
+    }
+}
 
-    void push(std::uint64_t key, int value) {
-        std::size_t idx = bucket_index(key ^ last);
-        buckets[idx].emplace_back(key, value);
-        ++sz;
+// Builds a CSR graph from parsed blocks with a counting sort by source, which
+// keeps each row in input order.
+Graph build_csr(std::size_t node_count, const std::vector<ParsedBlock>& blocks) {
+    std::vector<std::uint64_t> offsets = csr_offsets<std::uint64_t>(node_count, blocks);
+    std::vector<Edge> csr(offsets.back());
+    scatter_csr(offsets, blocks, csr.data());
+    return Graph(std::move(offsets), std::move(csr));
+}
+
+// Same as build_csr with 32-bit offsets, ids and weights; the caller checks
+// that they fit.
+NarrowGraph build_narrow_csr(std::size_t node_count, const std::vector<ParsedBlock>& blocks) {
+    std::vector<std::uint32_t> offsets = csr_offsets<std::uint32_t>(node_count, blocks);
+    std::vector<NarrowEdge> csr(offsets.back());
+    scatter_csr(offsets, blocks, csr.data());
+    return NarrowGraph(std::move(offsets), std::move(csr));
+}
+
+// Parses a decimal integer (optional '-') at p and advances p past it.
+bool parse_integer(const char*& p, const char* end, long long& value) {
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        ++p;
+    }
+    const char* digits = p;
+    unsigned long long v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        unsigned digit = static_cast<unsigned>(*p - '0');
+        if (v > (static_cast<unsigned long long>(std::numeric_limits<long long>::max()) - digit) / 10) {
+            return false;
+        }
+        v = v * 10 + digit;
+        ++p;
+    }
+    if (p == digits || (p < end && *p != ' ' && *p != '\t' && *p != '\r')) {
+        return false;
     }
+    value = negative ? -static_cast<long long>(v) : static_cast<long long>(v);
+    return true;
+}
 
-    std::pair<std::uint64_t, int> pop() {
-        if (buckets[0].empty()) {
-            relocate();
+// Parses all of `text` as a T for the command-line setting `what`. Unlike
+// std::stoull, a sign on an unsigned value, trailing junk or a value T
+// cannot hold is an error, and the message names the setting and the text.
+template <typename T>
+T parse_number(const std::string& what, const std::string& text) {
+    const char* begin = text.c_str();
+    char* stop = nullptr;
+    errno = 0;
+    bool ok = !text.empty() && !std::isspace(static_cast<unsigned char>(text[0]));
+    T value{};
+    if constexpr (std::is_floating_point_v<T>) {
+        const double parsed = std::strtod(begin, &stop);
+        ok = ok && std::isfinite(parsed);
+        value = static_cast<T>(parsed);
+    }
+    else if constexpr (std::is_unsigned_v<T>) {
+        const unsigned long long parsed = std::strtoull(begin, &stop, 10);
+        ok = ok && text[0] != '-' && parsed <= std::numeric_limits<T>::max();
+        value = static_cast<T>(parsed);
+    }
+    else {
+        const long long parsed = std::strtoll(begin, &stop, 10);
+        ok = ok && parsed >= std::numeric_limits<T>::min() && parsed <= std::numeric_limits<T>::max();
+        value = static_cast<T>(parsed);
+    }
+    if (errno == ERANGE || stop != begin + text.size()) {
+        ok = false;
+    }
+    if (!ok) {
+        throw std::runtime_error(what + " needs " + (std::is_floating_point_v<T> ? "a number" : "an integer")
+            + ", got '" + text + "'");
+    }
+    return value;
+}
+
+enum class InputFormat { edge_list, dimacs, snap, matrix_market, metis };
+
+const char* input_format_name(InputFormat format) {
+    switch (format) {
+    case InputFormat::dimacs: return "DIMACS";
+    case InputFormat::snap: return "SNAP";
+    case InputFormat::matrix_market: return "MatrixMarket";
+    case InputFormat::metis: return "METIS";
+    default: return "edge list";
+    }
+}
+
+// How to read the body of an input: its format plus whatever the header
+// line(s) declared.
+struct InputLayout {
+    InputFormat format = InputFormat::edge_list;
+    // Declared vertex and edge counts; ids are checked against the former.
+    std::optional<std::uint64_t> nodes;
+    std::optional<std::uint64_t> edges;
+    // SNAP counts distinct ids, which need not be dense: the graph has at
+    // least this many vertices, but ids may exceed it.
+    std::optional<std::uint64_t> min_nodes;
+    // MatrixMarket symmetric and SNAP undirected: mirror every edge that is
+    // not a self-loop.
+    bool symmetric = false;
+    // MatrixMarket: entries carry no value, values are real and get scaled
+    // and rounded.
+    bool pattern = false;
+    bool real_values = false;
+    double weight_scale = 1.0;
+    // METIS: neighbours come with edge weights; values leading each row.
+    bool metis_edge_weights = false;
+    int metis_vertex_values = 0;
+    // Edge list '# sssp-graph' header: counts are exact, weights are at most
+    // max_weight, and edges may be grouped by ascending source.
+    bool metadata_header = false;
+    std::optional<std::uint64_t> max_weight;
+    bool sorted_by_source = false;
+};
+
+// Calls fn(line, eol) for every line in [begin, end); eol excludes the '\n'.
+template <typename Fn>
+void for_each_line(const char* begin, const char* end, Fn fn) {
+    const char* line = begin;
+    while (line < end) {
+        const char* eol = static_cast<const char*>(std::memchr(line, '\n', static_cast<std::size_t>(end - line)));
+        if (!eol) {
+            eol = end;
         }
-        auto res = buckets[0].back();
-        buckets[0].pop_back();
-        --sz;
-        return res;
+        fn(line, eol);
+        line = eol + 1;
     }
+}
 
-private:
-    std::vector<std::vector<std::pair<std::uint64_t, int>>> buckets;
-    std::uint64_t last;
-    std::size_t sz;
+void skip_blanks(const char*& p, const char* eol) {
+    while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        ++p;
+    }
+}
 
-    static std::size_t bucket_index(std::uint64_t diff) {
-        if (diff == 0) {
-            return 0;
+// METIS has one line per vertex (blank for isolated ones); only lines
+// starting with '%' are comments.
+std::uint64_t count_metis_rows(const char* begin, const char* end) {
+    std::uint64_t rows = 0;
+    for_each_line(begin, end, [&](const char* line, const char*) {
+        rows += *line != '%' ? 1 : 0;
+    });
+    return rows;
+}
+
+// Validates one edge (ids already zero-based) and appends it to `block`.
+void add_parsed_edge(const InputLayout& layout, long long from, long long to, long long weight,
+    const char* line, const char* eol, ParsedBlock& block) {
+    const long long max_id = layout.nodes ? static_cast<long long>(*layout.nodes) - 1
+                                          : std::numeric_limits<int>::max();
+    if (from < 0 || to < 0) {
+        throw std::runtime_error(layout.format == InputFormat::edge_list || layout.format == InputFormat::snap
+                ? "Node ids must be non-negative: " + std::string(line, eol)
+                : "Node ids must be 1-based: " + std::string(line, eol));
+    }
+    if (from > max_id || to > max_id) {
+        throw std::runtime_error("Node id out of range in input file: " + std::string(line, eol));
+    }
+    if (weight < 0) {
+        throw std::runtime_error("Edge weights must be non-negative: " + std::string(line, eol));
+    }
+    if (layout.max_weight && static_cast<std::uint64_t>(weight) > *layout.max_weight) {
+        throw std::runtime_error("Edge weight exceeds the declared max_weight: " + std::string(line, eol));
+    }
+    block.edges.push_back({ static_cast<int>(from), static_cast<int>(to), static_cast<std::uint64_t>(weight) });
+    // A declared vertex count already sizes the graph.
+    if (!layout.nodes) {
+        block.max_node = std::max({ block.max_node, static_cast<int>(from), static_cast<int>(to) });
+    }
+}
+
+// Parses a MatrixMarket real value at p, scales it and rounds to an integer weight.
+bool parse_scaled_real(const char*& p, const char* eol, double scale, long long& value) {
+    char* stop = nullptr;
+    const double v = std::strtod(p, &stop) * scale;
+    if (stop == p || stop > eol || !(std::fabs(v) < 9.0e18)) {
+        return false;
+    }
+    p = stop;
+    value = std::llround(v);
+    return true;
+}
+
+// Parses the body lines in [begin, end) into `block`. `first_row` is the
+// vertex of the first METIS row in the range; other formats ignore it.
+void parse_input_lines(const InputLayout& layout, const char* begin, const char* end,
+    std::uint64_t first_row, ParsedBlock& block) {
+    std::uint64_t row = first_row;
+    for_each_line(begin, end, [&](const char* line, const char* eol) {
+        const char* p = line;
+        auto invalid = [&]() {
+            return std::runtime_error("Invalid line in input file: " + std::string(line, eol));
+        };
+        long long from = 0, to = 0, weight = 1;
+        switch (layout.format) {
+        case InputFormat::edge_list:
+        case InputFormat::snap: {
+            skip_blanks(p, eol);
+            if (p == eol || *p == '#' || *p == '%') {
+                return;
+            }
+            bool ok = parse_integer(p, eol, from);
+            skip_blanks(p, eol);
+            ok = ok && parse_integer(p, eol, to);
+            skip_blanks(p, eol);
+            // SNAP edge lists are usually unweighted.
+            if (layout.format == InputFormat::edge_list || p < eol) {
+                ok = ok && parse_integer(p, eol, weight);
+            }
+            if (!ok) {
+                throw invalid();
+            }
+            add_parsed_edge(layout, from, to, weight, line, eol, block);
+            if (layout.symmetric && from != to) {
+                add_parsed_edge(layout, to, from, weight, line, eol, block);
+            }
+            return;
+        }
+        case InputFormat::dimacs: {
+            skip_blanks(p, eol);
+            if (p == eol || *p == 'c' || *p == 'p') {
+                return;
+            }
+            if (*p++ != 'a') {
+                throw invalid();
+            }
+            skip_blanks(p, eol);
+            bool ok = parse_integer(p, eol, from);
+            skip_blanks(p, eol);
+            ok = ok && parse_integer(p, eol, to);
+            skip_blanks(p, eol);
+            ok = ok && parse_integer(p, eol, weight);
+            if (!ok) {
+                throw invalid();
+            }
+            add_parsed_edge(layout, from - 1, to - 1, weight, line, eol, block);
+            return;
+        }
+        case InputFormat::matrix_market: {
+            skip_blanks(p, eol);
+            if (p == eol || *p == '%') {
+                return;
+            }
+            bool ok = parse_integer(p, eol, from);
+            skip_blanks(p, eol);
+            ok = ok && parse_integer(p, eol, to);
+            skip_blanks(p, eol);
+            if (!layout.pattern) {
+                ok = ok && (layout.real_values ? parse_scaled_real(p, eol, layout.weight_scale, weight)
+                                               : parse_integer(p, eol, weight));
+            }
+            if (!ok) {
+                throw invalid();
+            }
+            add_parsed_edge(layout, from - 1, to - 1, weight, line, eol, block);
+            if (layout.symmetric && from != to) {
+                add_parsed_edge(layout, to - 1, from - 1, weight, line, eol, block);
+            }
+            return;
+        }
+        case InputFormat::metis: {
+            if (*line == '%') {
+                return;
+            }
+            const std::uint64_t vertex = row++;
+            skip_blanks(p, eol);
+            if (vertex >= layout.nodes.value_or(0)) {
+                if (p == eol) {
+                    return;
+                }
+                throw std::runtime_error("METIS input has more adjacency lines than vertices: " + std::string(line, eol));
+            }
+            for (int i = 0; i < layout.metis_vertex_values; ++i) {
+                long long ignored;
+                if (!parse_integer(p, eol, ignored)) {
+                    throw invalid();
+                }
+                skip_blanks(p, eol);
+            }
+            while (p < eol) {
+                bool ok = parse_integer(p, eol, to);
+                skip_blanks(p, eol);
+                if (layout.metis_edge_weights) {
+                    ok = ok && parse_integer(p, eol, weight);
+                    skip_blanks(p, eol);
+                }
+                if (!ok) {
+                    throw invalid();
+                }
+                add_parsed_edge(layout, static_cast<long long>(vertex), to - 1, weight, line, eol, block);
+            }
+            return;
+        }
+        }
+    });
+}
+
+// Picks the input format: an explicit --format, else the file extension
+// (ignoring a compression suffix), else a look at the first lines.
+InputFormat resolve_input_format(const std::string& requested, std::string path, const std::string& head) {
+    if (requested == "edge") {
+        return InputFormat::edge_list;
+    }
+    if (requested == "dimacs") {
+        return InputFormat::dimacs;
+    }
+    if (requested == "snap") {
+        return InputFormat::snap;
+    }
+    if (requested == "mtx") {
+        return InputFormat::matrix_market;
+    }
+    if (requested == "metis") {
+        return InputFormat::metis;
+    }
+    if (requested != "auto") {
+        throw std::runtime_error("Unknown input format: " + requested);
+    }
+    auto ends_with = [&](const char* suffix) {
+        const std::size_t n = std::strlen(suffix);
+        return path.size() >= n && path.compare(path.size() - n, n, suffix) == 0;
+    };
+    for (const char* suffix : { ".gz", ".bgz", ".zst", ".zstd" }) {
+        if (ends_with(suffix)) {
+            path.resize(path.size() - std::strlen(suffix));
+            break;
+        }
+    }
+    if (ends_with(".gr")) {
+        return InputFormat::dimacs;
+    }
+    if (ends_with(".mtx")) {
+        return InputFormat::matrix_market;
+    }
+    if (ends_with(".graph") || ends_with(".metis")) {
+        return InputFormat::metis;
+    }
+    if (head.rfind("%%MatrixMarket", 0) == 0) {
+        return InputFormat::matrix_market;
+    }
+    InputFormat sniffed = InputFormat::edge_list;
+    bool decided = false;
+    for_each_line(head.data(), head.data() + head.size(), [&](const char* line, const char* eol) {
+        if (decided || line == eol) {
+            return;
+        }
+        const std::string text(line, eol);
+        if (text.rfind("p sp ", 0) == 0 || text.rfind("a ", 0) == 0) {
+            sniffed = InputFormat::dimacs;
+            decided = true;
+        }
+        else if (text.rfind("# Nodes:", 0) == 0 || text.rfind("# Directed", 0) == 0
+            || text.rfind("# Undirected", 0) == 0) {
+            sniffed = InputFormat::snap;
+            decided = true;
+        }
+        else if (text[0] != '#' && text[0] != 'c') {
+            decided = true;
+        }
+    });
+    return sniffed;
+}
+
+// Reads the header of `layout.format` from the start of `head` into `layout`
+// and returns how many bytes of `head` it used; the rest is body.
+std::size_t parse_input_header(const std::string& head, InputLayout& layout) {
+    std::size_t used = 0;
+    bool found = false;
+    auto unsigned_value = [](const char*& p, const char* eol, std::uint64_t& value) {
+        long long v;
+        skip_blanks(p, eol);
+        if (!parse_integer(p, eol, v) || v < 0) {
+            return false;
+        }
+        value = static_cast<std::uint64_t>(v);
+        return true;
+    };
+    // `copies` edges per declared one (mirrored formats). A count no edge
+    // array could hold is a header error, not an allocation to attempt.
+    auto edge_count = [&](std::uint64_t declared, std::uint64_t copies, const std::string& text) {
+        if (declared > std::vector<ParsedEdge>().max_size() / copies) {
+            throw std::runtime_error(std::string(input_format_name(layout.format))
+                + " header declares an impossible edge count: " + text);
+        }
+        return declared * copies;
+    };
+    for_each_line(head.data(), head.data() + head.size(), [&](const char* line, const char* eol) {
+        if (found || eol == head.data() + head.size()) {
+            return;
+        }
+        const std::string text(line, eol);
+        const char* p = line;
+        switch (layout.format) {
+        case InputFormat::dimacs: {
+            // The problem line stays in the body, where the parser skips it.
+            if (text.rfind("p sp", 0) == 0) {
+                p += 4;
+                std::uint64_t n, m;
+                if (!unsigned_value(p, eol, n) || !unsigned_value(p, eol, m)) {
+                    throw std::runtime_error("Invalid DIMACS problem line: " + text);
+                }
+                layout.nodes = n;
+                layout.edges = edge_count(m, 1, text);
+                found = true;
+            }
+            else if (text.rfind("a ", 0) == 0) {
+                found = true;
+            }
+            return;
+        }
+        case InputFormat::matrix_market: {
+            if (used == 0) {
+                std::istringstream banner(text);
+                std::string tag, object, storage, field, symmetry;
+                banner >> tag >> object >> storage >> field >> symmetry;
+                for (auto* s : { &object, &storage, &field, &symmetry }) {
+                    std::transform(s->begin(), s->end(), s->begin(),
+                        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                }
+                if (tag != "%%MatrixMarket" || object != "matrix" || storage != "coordinate") {
+                    throw std::runtime_error("Only MatrixMarket coordinate matrices are supported: " + text);
+                }
+                if (field != "real" && field != "integer" && field != "pattern") {
+                    throw std::runtime_error("Unsupported MatrixMarket field: " + field);
+                }
+                if (symmetry != "general" && symmetry != "symmetric") {
+                    throw std::runtime_error("Unsupported MatrixMarket symmetry: " + symmetry);
+                }
+                layout.real_values = field == "real";
+                layout.pattern = field == "pattern";
+                layout.symmetric = symmetry == "symmetric";
+            }
+            else if (!text.empty() && text[0] != '%' && text.find_first_not_of(" \t\r") != std::string::npos) {
+                std::uint64_t rows, cols, entries;
+                if (!unsigned_value(p, eol, rows) || !unsigned_value(p, eol, cols)
+                    || !unsigned_value(p, eol, entries)) {
+                    throw std::runtime_error("Invalid MatrixMarket size line: " + text);
+                }
+                layout.nodes = std::max(rows, cols);
+                layout.edges = edge_count(entries, layout.symmetric ? 2 : 1, text);
+                found = true;
+            }
+            used = static_cast<std::size_t>(eol - head.data()) + 1;
+            return;
+        }
+        case InputFormat::metis: {
+            used = static_cast<std::size_t>(eol - head.data()) + 1;
+            if (text.empty() || text[0] == '%') {
+                return;
+            }
+            std::uint64_t n, m, format = 0, constraints = 1;
+            if (!unsigned_value(p, eol, n) || !unsigned_value(p, eol, m)) {
+                throw std::runtime_error("Invalid METIS header: " + text);
+            }
+            skip_blanks(p, eol);
+            if (p < eol && !unsigned_value(p, eol, format)) {
+                throw std::runtime_error("Invalid METIS header: " + text);
+            }
+            skip_blanks(p, eol);
+            if (p < eol && !unsigned_value(p, eol, constraints)) {
+                throw std::runtime_error("Invalid METIS header: " + text);
+            }
+            // fmt digits: vertex size, vertex weights, edge weights.
+            layout.nodes = n;
+            layout.edges = edge_count(m, 2, text);
+            layout.metis_edge_weights = format % 10 == 1;
+            layout.metis_vertex_values = static_cast<int>((format / 10 % 10 == 1 ? constraints : 0)
+                + (format / 100 % 10 == 1 ? 1 : 0));
+            found = true;
+            return;
+        }
+        case InputFormat::edge_list: {
+            // '# sssp-graph nodes=N edges=M max_weight=W sorted_by_source=0|1'
+            // may lead the comments; the parser skips it like any comment.
+            if (text.rfind("# sssp-graph", 0) == 0) {
+                std::istringstream fields(text.substr(12));
+                std::string field;
+                while (fields >> field) {
+                    const auto eq = field.find('=');
+                    const std::string key = field.substr(0, eq);
+                    std::uint64_t value = 0;
+                    const char* v = field.c_str() + (eq == std::string::npos ? field.size() : eq + 1);
+                    const char* v_end = field.c_str() + field.size();
+                    if (eq == std::string::npos || !unsigned_value(v, v_end, value)) {
+                        throw std::runtime_error("Invalid sssp-graph header: " + text);
+                    }
+                    if (key == "nodes") {
+                        layout.nodes = value;
+                    }
+                    else if (key == "edges") {
+                        layout.edges = edge_count(value, 1, text);
+                    }
+                    else if (key == "max_weight") {
+                        layout.max_weight = value;
+                    }
+                    else if (key == "sorted_by_source") {
+                        layout.sorted_by_source = value != 0;
+                    }
+                }
+                layout.metadata_header = true;
+                found = true;
+            }
+            else if (text.empty() || text[0] != '#') {
+                found = true;
+            }
+            return;
+        }
+        case InputFormat::snap: {
+            // '# Directed graph' or '# Undirected graph', then
+            // '# Nodes: N Edges: M', among other comments.
+            if (text.empty() || text[0] != '#') {
+                found = true;
+                return;
+            }
+            if (text.rfind("# Undirected", 0) == 0) {
+                layout.symmetric = true;
+                if (layout.edges) {
+                    layout.edges = edge_count(*layout.edges, 2, text);
+                }
+            }
+            else if (text.rfind("# Nodes:", 0) == 0) {
+                p += 8;
+                std::uint64_t n, m;
+                if (!unsigned_value(p, eol, n)) {
+                    throw std::runtime_error("Invalid SNAP header: " + text);
+                }
+                skip_blanks(p, eol);
+                if (eol - p < 6 || std::strncmp(p, "Edges:", 6) != 0) {
+                    throw std::runtime_error("Invalid SNAP header: " + text);
+                }
+                p += 6;
+                if (!unsigned_value(p, eol, m)) {
+                    throw std::runtime_error("Invalid SNAP header: " + text);
+                }
+                layout.min_nodes = n;
+                // Undirected files store each edge once; it is loaded twice.
+                layout.edges = edge_count(m, layout.symmetric ? 2 : 1, text);
+            }
+            return;
+        }
+        default:
+            found = true;
+            return;
+        }
+    });
+    if (!found && (layout.format == InputFormat::matrix_market || layout.format == InputFormat::metis)) {
+        throw std::runtime_error(std::string("Missing ") + input_format_name(layout.format) + " header");
+    }
+    const auto int_max = static_cast<std::uint64_t>(std::numeric_limits<int>::max());
+    if ((layout.nodes && *layout.nodes > int_max) || (layout.min_nodes && *layout.min_nodes > int_max)) {
+        throw std::runtime_error("Graph declares more vertices than this build supports");
+    }
+    return layout.format == InputFormat::dimacs ? 0 : used;
+}
+
+// Positional reads of one file with completion tracked per buffer slot.
+class AsyncReadBackend {
+public:
+    virtual ~AsyncReadBackend() = default;
+    virtual const char* name() const = 0;
+    virtual void submit(std::size_t slot, char* buffer, std::size_t length, std::uint64_t offset) = 0;
+    // Blocks until the read in `slot` finished; returns the bytes read.
+    virtual std::size_t wait(std::size_t slot) = 0;
+};
+
+#if defined(__unix__)
+// Reads exactly `length` bytes unless EOF comes first.
+std::size_t pread_fully(int fd, char* buffer, std::size_t length, std::uint64_t offset) {
+    std::size_t done = 0;
+    while (done < length) {
+        ssize_t n = pread(fd, buffer + done, length - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error("Failed to read input file");
+        }
+        if (n == 0) {
+            break;
+        }
+        done += static_cast<std::size_t>(n);
+    }
+    return done;
+}
+
+// Portable fallback: a few threads issuing blocking pread() calls.
+class PreadPoolBackend : public AsyncReadBackend {
+public:
+    PreadPoolBackend(int fd, std::size_t slots, int threads) : fd(fd), results(slots) {
+        for (int i = 0; i < threads; ++i) {
+            pool.emplace_back([this] { run(); });
+        }
+    }
+    ~PreadPoolBackend() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        for (auto& t : pool) {
+            t.join();
+        }
+    }
+
+    const char* name() const override { return "pread pool"; }
+
+    void submit(std::size_t slot, char* buffer, std::size_t length, std::uint64_t offset) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            results[slot] = Result{};
+            jobs.push_back({ slot, buffer, length, offset });
+        }
+        changed.notify_all();
+    }
+
+    std::size_t wait(std::size_t slot) override {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return results[slot].done; });
+        if (results[slot].failed) {
+            throw std::runtime_error("Failed to read input file");
+        }
+        return results[slot].bytes;
+    }
+
+private:
+    struct Job {
+        std::size_t slot;
+        char* buffer;
+        std::size_t length;
+        std::uint64_t offset;
+    };
+    struct Result {
+        bool done = false;
+        bool failed = false;
+        std::size_t bytes = 0;
+    };
+
+    int fd;
+    std::vector<Result> results;
+    std::deque<Job> jobs;
+    std::vector<std::thread> pool;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool stopping = false;
+
+    void run() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return;
+                }
+                job = jobs.front();
+                jobs.pop_front();
+            }
+            Result result;
+            result.done = true;
+            try {
+                result.bytes = pread_fully(fd, job.buffer, job.length, job.offset);
+            }
+            catch (const std::exception&) {
+                result.failed = true;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[job.slot] = result;
+            }
+            changed.notify_all();
+        }
+    }
+};
+#endif
+
+#if defined(__linux__)
+// io_uring through the raw syscalls (no liburing dependency): one READV per
+// buffer slot, submitted without blocking and reaped on demand.
+class IoUringBackend : public AsyncReadBackend {
+public:
+    IoUringBackend(int fd, std::size_t slots) : fd(fd), iovecs(slots), results(slots) {
+        io_uring_params params{};
+        ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(slots), &params));
+        if (ring_fd < 0) {
+            throw std::runtime_error("io_uring is not available");
+        }
+        sq_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            sq_bytes = cq_bytes = std::max(sq_bytes, cq_bytes);
+        }
+        sqes_bytes = params.sq_entries * sizeof(io_uring_sqe);
+        // A failed mapping unwinds the ones before it and the ring fd.
+        try {
+            sq_ring = map_ring(sq_bytes, IORING_OFF_SQ_RING);
+            cq_ring = single_mmap ? sq_ring : map_ring(cq_bytes, IORING_OFF_CQ_RING);
+            sqes = static_cast<io_uring_sqe*>(map_ring(sqes_bytes, IORING_OFF_SQES));
+        }
+        catch (...) {
+            release();
+            throw;
+        }
+
+        auto* sq = static_cast<char*>(sq_ring);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        auto* cq = static_cast<char*>(cq_ring);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~IoUringBackend() override { release(); }
+
+    const char* name() const override { return "io_uring"; }
+
+    void submit(std::size_t slot, char* buffer, std::size_t length, std::uint64_t offset) override {
+        iovecs[slot] = { buffer, length };
+        results[slot] = Result{ false, 0, buffer, length, offset };
+        unsigned tail = *sq_tail;
+        unsigned index = tail & sq_mask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<std::uint64_t>(&iovecs[slot]);
+        sqe.len = 1;
+        sqe.off = offset;
+        sqe.user_data = slot;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        if (syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0) < 0) {
+            throw std::runtime_error("io_uring submission failed");
+        }
+    }
+
+    std::size_t wait(std::size_t slot) override {
+        while (!results[slot].done) {
+            reap();
+            if (!results[slot].done
+                && syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0
+                && errno != EINTR) {
+                throw std::runtime_error("io_uring wait failed");
+            }
+        }
+        const Result& r = results[slot];
+        if (r.status < 0) {
+            throw std::runtime_error("Failed to read input file");
+        }
+        std::size_t bytes = static_cast<std::size_t>(r.status);
+        // Short reads before EOF are rare for files; finish them synchronously.
+        if (bytes > 0 && bytes < r.length) {
+            bytes += pread_fully(fd, r.buffer + bytes, r.length - bytes, r.offset + bytes);
+        }
+        return bytes;
+    }
+
+private:
+    struct Result {
+        bool done;
+        long long status;
+        char* buffer;
+        std::size_t length;
+        std::uint64_t offset;
+    };
+
+    int fd;
+    int ring_fd = -1;
+    std::vector<iovec> iovecs;
+    std::vector<Result> results;
+    void* sq_ring = nullptr;
+    void* cq_ring = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    std::size_t sq_bytes = 0;
+    std::size_t cq_bytes = 0;
+    std::size_t sqes_bytes = 0;
+    unsigned* sq_tail = nullptr;
+    unsigned sq_mask = 0;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    void* map_ring(std::size_t bytes, off_t offset) {
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("io_uring is not available");
+        }
+        return p;
+    }
+
+    void release() {
+        if (sqes) {
+            munmap(sqes, sqes_bytes);
+        }
+        if (cq_ring && cq_ring != sq_ring) {
+            munmap(cq_ring, cq_bytes);
+        }
+        if (sq_ring) {
+            munmap(sq_ring, sq_bytes);
+        }
+        if (ring_fd >= 0) {
+            close(ring_fd);
+        }
+    }
+
+    void reap() {
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            const io_uring_cqe& cqe = cqes[head & cq_mask];
+            Result& r = results[static_cast<std::size_t>(cqe.user_data)];
+            r.done = true;
+            r.status = cqe.res;
+            ++head;
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+};
+#endif
+
+// Input bytes delivered to the parser chunk by chunk, in file order.
+class ChunkSource {
+public:
+    virtual ~ChunkSource() = default;
+    // How the bytes are produced, for the load report.
+    virtual std::string describe() const = 0;
+    // Size of the input on disk.
+    virtual std::uint64_t file_size() const = 0;
+    // Bytes next() will deliver in total, when known before reading (0
+    // otherwise): the file size of an uncompressed regular file.
+    virtual std::uint64_t text_size() const { return 0; }
+    // Points `data` at the next chunk, valid until the following call.
+    // Returns false at end of input.
+    virtual bool next(const char*& data, std::size_t& length) = 0;
+};
+
+#if defined(__unix__)
+// Streams a file as consecutive chunks with `depth` reads in flight: while
+// the caller works on chunk i, chunks i+1 .. i+depth-1 are being read.
+// Pipes and other non-regular inputs have no usable size, so they are read
+// sequentially until EOF instead.
+class ReadAheadFile : public ChunkSource {
+public:
+    ReadAheadFile(const std::string& path, const LoadOptions& opts)
+        : chunk_bytes(opts.chunk_bytes), depth(std::max<std::size_t>(2, opts.read_depth)) {
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open input file: " + path);
+        }
+        // The destructor does not run for a throwing constructor, so the
+        // same teardown runs here: in-flight reads land, then fd closes.
+        try {
+            start(path, opts);
+        }
+        catch (...) {
+            release();
+            throw;
+        }
+    }
+    ~ReadAheadFile() override { release(); }
+    ReadAheadFile(const ReadAheadFile&) = delete;
+    ReadAheadFile& operator=(const ReadAheadFile&) = delete;
+
+    std::string describe() const override { return streaming ? "sequential read" : backend->name(); }
+    // For streamed inputs, the bytes read so far.
+    std::uint64_t file_size() const override { return file_bytes; }
+    std::uint64_t text_size() const override { return streaming ? 0 : file_bytes; }
+
+    // The previous chunk's buffer is recycled for the next read.
+    bool next(const char*& data, std::size_t& length) override {
+        if (streaming) {
+            return next_streamed(data, length);
+        }
+        if (next_chunk > 0) {
+            issue(next_chunk - 1 + depth);
+        }
+        if (next_chunk >= issued) {
+            return false;
+        }
+        std::size_t slot = next_chunk % depth;
+        length = backend->wait(slot);
+        data = buffers[slot].get();
+        ++next_chunk;
+        return true;
+    }
+
+private:
+    void start(const std::string& path, const LoadOptions& opts) {
+        struct stat info {};
+        if (fstat(fd, &info) != 0) {
+            throw std::runtime_error("Failed to stat input file: " + path);
+        }
+        if (!S_ISREG(info.st_mode)) {
+            streaming = true;
+            buffers.emplace_back(new char[chunk_bytes]);
+            return;
+        }
+        file_bytes = static_cast<std::uint64_t>(info.st_size);
+        buffers.resize(depth);
+        for (auto& buffer : buffers) {
+            buffer.reset(new char[chunk_bytes]);
+        }
+        backend = make_backend(opts.io_backend);
+        for (std::size_t c = 0; c < depth; ++c) {
+            issue(c);
+        }
+    }
+
+    // Lets outstanding reads land before their buffers go away.
+    void release() {
+        for (std::size_t c = next_chunk; c < issued; ++c) {
+            try {
+                backend->wait(c % depth);
+            }
+            catch (const std::exception&) {
+            }
+        }
+        backend.reset();
+        close(fd);
+    }
+
+    int fd = -1;
+    bool streaming = false;
+    std::uint64_t file_bytes = 0;
+    std::size_t chunk_bytes;
+    std::size_t depth;
+    std::vector<std::unique_ptr<char[]>> buffers;
+    std::unique_ptr<AsyncReadBackend> backend;
+    std::size_t issued = 0;
+    std::size_t next_chunk = 0;
+
+    std::unique_ptr<AsyncReadBackend> make_backend(const std::string& choice) {
+#if defined(__linux__)
+        if (choice == "auto" || choice == "uring") {
+            try {
+                return std::make_unique<IoUringBackend>(fd, depth);
+            }
+            catch (const std::exception&) {
+                if (choice == "uring") {
+                    throw;
+                }
+            }
+        }
+#endif
+        if (choice != "auto" && choice != "pread" && choice != "uring") {
+            throw std::runtime_error("Unknown I/O backend: " + choice);
+        }
+        if (choice == "uring") {
+            throw std::runtime_error("io_uring is not available");
+        }
+        return std::make_unique<PreadPoolBackend>(fd, depth, static_cast<int>(std::min<std::size_t>(depth, 4)));
+    }
+
+    void issue(std::size_t chunk) {
+        std::uint64_t offset = static_cast<std::uint64_t>(chunk) * chunk_bytes;
+        if (offset >= file_bytes || chunk != issued) {
+            return;
+        }
+        std::size_t length = static_cast<std::size_t>(
+            std::min<std::uint64_t>(chunk_bytes, file_bytes - offset));
+        backend->submit(chunk % depth, buffers[chunk % depth].get(), length, offset);
+        ++issued;
+    }
+
+    // Fills the single buffer from the stream, stopping early only at EOF.
+    bool next_streamed(const char*& data, std::size_t& length) {
+        char* buffer = buffers.front().get();
+        length = 0;
+        while (length < chunk_bytes) {
+            ssize_t got = read(fd, buffer + length, chunk_bytes - length);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got < 0) {
+                throw std::runtime_error("Failed to read input file");
+            }
+            if (got == 0) {
+                break;
+            }
+            length += static_cast<std::size_t>(got);
+        }
+        file_bytes += length;
+        data = buffer;
+        return length > 0;
+    }
+};
+#else
+// Without POSIX I/O the chunks are read synchronously with an ifstream.
+class ReadAheadFile : public ChunkSource {
+public:
+    ReadAheadFile(const std::string& path, const LoadOptions& opts)
+        : in(path, std::ios::binary), buffer(opts.chunk_bytes) {
+        if (!in) {
+            throw std::runtime_error("Failed to open input file: " + path);
+        }
+        in.seekg(0, std::ios::end);
+        file_bytes = static_cast<std::uint64_t>(in.tellg());
+        in.seekg(0);
+    }
+
+    std::string describe() const override { return "ifstream"; }
+    std::uint64_t file_size() const override { return file_bytes; }
+    std::uint64_t text_size() const override { return file_bytes; }
+
+    bool next(const char*& data, std::size_t& length) override {
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        length = static_cast<std::size_t>(in.gcount());
+        data = buffer.data();
+        return length > 0;
+    }
+
+private:
+    std::ifstream in;
+    std::vector<char> buffer;
+    std::uint64_t file_bytes = 0;
+};
+#endif
+
+// Whole input file made addressable for the decompressors: mapped read-only
+// where mmap exists, read into memory otherwise.
+class MappedInput {
+public:
+    explicit MappedInput(const std::string& path) {
+#if defined(__unix__)
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open input file: " + path);
+        }
+        struct stat info {};
+        fstat(fd, &info);
+        bytes = static_cast<std::size_t>(info.st_size);
+        if (bytes > 0) {
+            void* p = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Failed to map input file: " + path);
+            }
+            madvise(p, bytes, MADV_SEQUENTIAL);
+            mapped = static_cast<const unsigned char*>(p);
+        }
+        close(fd);
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Failed to open input file: " + path);
+        }
+        copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        bytes = copy.size();
+        mapped = reinterpret_cast<const unsigned char*>(copy.data());
+#endif
+    }
+    ~MappedInput() {
+#if defined(__unix__)
+        if (mapped) {
+            munmap(const_cast<unsigned char*>(mapped), bytes);
+        }
+#endif
+    }
+    MappedInput(const MappedInput&) = delete;
+    MappedInput& operator=(const MappedInput&) = delete;
+
+    const unsigned char* data() const { return mapped; }
+    std::size_t size() const { return bytes; }
+
+private:
+    const unsigned char* mapped = nullptr;
+    std::size_t bytes = 0;
+#if !defined(__unix__)
+    std::vector<char> copy;
+#endif
+};
+
+enum class Compression { none, gzip, zstd };
+
+Compression detect_compression(const std::string& path) {
+#if defined(__unix__)
+    // Sniffing a pipe would consume its first bytes; streamed input is
+    // taken as plain text.
+    struct stat info {};
+    if (stat(path.c_str(), &info) == 0 && !S_ISREG(info.st_mode)) {
+        return Compression::none;
+    }
+#endif
+    std::ifstream in(path, std::ios::binary);
+    unsigned char magic[4] = {};
+    in.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    if (in.gcount() >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        return Compression::gzip;
+    }
+    if (in.gcount() == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+        return Compression::zstd;
+    }
+    return Compression::none;
+}
+
+// Byte range of one independently decodable unit (gzip member, zstd frame).
+struct CompressedUnit {
+    std::size_t offset;
+    std::size_t length;
+};
+
+// Decodes independent units on `threads` threads a window at a time and hands
+// them out in file order, so decoding window k+1 overlaps parsing window k.
+class ParallelUnitSource : public ChunkSource {
+public:
+    using Decoder = std::function<std::string(const unsigned char*, std::size_t)>;
+
+    ParallelUnitSource(std::unique_ptr<MappedInput> input, std::vector<CompressedUnit> units,
+        Decoder decode, int threads, std::string label)
+        : input(std::move(input)), units(std::move(units)), decode(std::move(decode)),
+          threads(threads), label(std::move(label)) {}
+
+    std::string describe() const override {
+        return label + " (" + std::to_string(units.size()) + " units, "
+            + std::to_string(threads) + " threads)";
+    }
+    std::uint64_t file_size() const override { return input->size(); }
+
+    bool next(const char*& data, std::size_t& length) override {
+        if (cursor == window.size()) {
+            if (next_unit == units.size()) {
+                return false;
+            }
+            const std::size_t count = std::min(units.size() - next_unit,
+                std::max<std::size_t>(64, static_cast<std::size_t>(threads) * 16));
+            window.assign(count, std::string());
+            const std::size_t base = next_unit;
+            parallel_for(count, threads, [&](std::size_t i) {
+                const CompressedUnit& unit = units[base + i];
+                window[i] = decode(input->data() + unit.offset, unit.length);
+            });
+            next_unit += count;
+            cursor = 0;
+        }
+        data = window[cursor].data();
+        length = window[cursor].size();
+        ++cursor;
+        return true;
+    }
+
+private:
+    std::unique_ptr<MappedInput> input;
+    std::vector<CompressedUnit> units;
+    Decoder decode;
+    int threads;
+    std::string label;
+    std::vector<std::string> window;
+    std::size_t cursor = 0;
+    std::size_t next_unit = 0;
+};
+
+#if defined(SSSP_WITH_ZLIB)
+// Member boundaries of a BGZF file (gzip members carrying their compressed
+// size in a "BC" extra field). Returns nothing for ordinary gzip files.
+std::vector<CompressedUnit> bgzf_members(const unsigned char* p, std::size_t n) {
+    std::vector<CompressedUnit> members;
+    std::size_t offset = 0;
+    while (offset < n) {
+        const unsigned char* h = p + offset;
+        if (n - offset < 18 || h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || !(h[3] & 4)) {
+            return {};
+        }
+        const std::size_t xlen = h[10] | (h[11] << 8);
+        std::size_t block_size = 0;
+        for (std::size_t x = 12; x + 4 <= 12 + xlen && offset + x + 4 <= n;) {
+            const std::size_t sub_len = h[x + 2] | (h[x + 3] << 8);
+            if (h[x] == 'B' && h[x + 1] == 'C' && sub_len == 2 && offset + x + 6 <= n) {
+                block_size = (h[x + 4] | (h[x + 5] << 8)) + std::size_t{ 1 };
+                break;
+            }
+            x += 4 + sub_len;
+        }
+        if (block_size == 0 || offset + block_size > n) {
+            return {};
+        }
+        members.push_back({ offset, block_size });
+        offset += block_size;
+    }
+    return members;
+}
+
+// Inflates one complete gzip member; the trailer's ISIZE presizes the output.
+std::string inflate_gzip_member(const unsigned char* p, std::size_t n) {
+    std::string out;
+    if (n >= 4) {
+        out.resize(p[n - 4] | (p[n - 3] << 8) | (p[n - 2] << 16) | (std::size_t{ p[n - 1] } << 24));
+    }
+    z_stream zs{};
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+        throw std::runtime_error("Failed to initialise zlib");
+    }
+    zs.next_in = const_cast<unsigned char*>(p);
+    zs.avail_in = static_cast<uInt>(n);
+    zs.next_out = reinterpret_cast<unsigned char*>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+    int status = inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+    if (status != Z_STREAM_END || zs.total_out != out.size()) {
+        throw std::runtime_error("Corrupt gzip block in input file");
+    }
+    return out;
+}
+
+// Sequential inflate for ordinary (single- or multi-member) gzip files.
+class GzipStreamSource : public ChunkSource {
+public:
+    GzipStreamSource(std::unique_ptr<MappedInput> input, std::size_t chunk_bytes)
+        : input(std::move(input)), buffer(chunk_bytes) {
+        if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+            throw std::runtime_error("Failed to initialise zlib");
+        }
+        zs.next_in = const_cast<unsigned char*>(this->input->data());
+        zs.avail_in = static_cast<uInt>(std::min<std::size_t>(this->input->size(), std::numeric_limits<uInt>::max()));
+    }
+    ~GzipStreamSource() override { inflateEnd(&zs); }
+
+    std::string describe() const override { return "gzip stream"; }
+    std::uint64_t file_size() const override { return input->size(); }
+
+    bool next(const char*& data, std::size_t& length) override {
+        zs.next_out = reinterpret_cast<unsigned char*>(buffer.data());
+        zs.avail_out = static_cast<uInt>(buffer.size());
+        while (zs.avail_out > 0 && !finished) {
+            refill();
+            int status = inflate(&zs, Z_NO_FLUSH);
+            if (status == Z_STREAM_END) {
+                // Concatenated members continue after the trailer.
+                refill();
+                if (zs.avail_in == 0) {
+                    finished = true;
+                }
+                else {
+                    inflateReset(&zs);
+                }
+            }
+            else if (status != Z_OK) {
+                throw std::runtime_error("Corrupt gzip stream in input file");
+            }
+        }
+        data = buffer.data();
+        length = buffer.size() - zs.avail_out;
+        return length > 0;
+    }
+
+private:
+    std::unique_ptr<MappedInput> input;
+    std::vector<char> buffer;
+    z_stream zs{};
+    bool finished = false;
+
+    // zlib counts input in uInt; feed files larger than 4 GiB in slices.
+    void refill() {
+        if (zs.avail_in > 0) {
+            return;
+        }
+        std::size_t consumed = static_cast<std::size_t>(zs.next_in - input->data());
+        std::size_t left = input->size() - consumed;
+        zs.avail_in = static_cast<uInt>(std::min<std::size_t>(left, std::numeric_limits<uInt>::max()));
+    }
+};
+#endif
+
+#if defined(SSSP_WITH_ZSTD)
+std::vector<CompressedUnit> zstd_frames(const unsigned char* p, std::size_t n) {
+    std::vector<CompressedUnit> frames;
+    for (std::size_t offset = 0; offset < n;) {
+        std::size_t size = ZSTD_findFrameCompressedSize(p + offset, n - offset);
+        if (ZSTD_isError(size)) {
+            throw std::runtime_error("Corrupt zstd frame in input file");
+        }
+        frames.push_back({ offset, size });
+        offset += size;
+    }
+    return frames;
+}
+
+std::string decompress_zstd_frame(const unsigned char* p, std::size_t n) {
+    std::string out;
+    unsigned long long content = ZSTD_getFrameContentSize(p, n);
+    if (content != ZSTD_CONTENTSIZE_UNKNOWN && content != ZSTD_CONTENTSIZE_ERROR) {
+        out.resize(static_cast<std::size_t>(content));
+        std::size_t got = ZSTD_decompress(&out[0], out.size(), p, n);
+        if (ZSTD_isError(got) || got != out.size()) {
+            throw std::runtime_error("Corrupt zstd frame in input file");
+        }
+        return out;
+    }
+    // No size in the header: stream the frame.
+    ZSTD_DStream* ds = ZSTD_createDStream();
+    ZSTD_initDStream(ds);
+    ZSTD_inBuffer in{ p, n, 0 };
+    std::vector<char> chunk(ZSTD_DStreamOutSize());
+    while (in.pos < in.size) {
+        ZSTD_outBuffer o{ chunk.data(), chunk.size(), 0 };
+        std::size_t status = ZSTD_decompressStream(ds, &o, &in);
+        if (ZSTD_isError(status)) {
+            ZSTD_freeDStream(ds);
+            throw std::runtime_error("Corrupt zstd frame in input file");
+        }
+        out.append(chunk.data(), o.pos);
+        if (status == 0) {
+            break;
+        }
+    }
+    ZSTD_freeDStream(ds);
+    return out;
+}
+
+// Sequential decompression of a single-frame zstd file, one chunk at a time.
+class ZstdStreamSource : public ChunkSource {
+public:
+    ZstdStreamSource(std::unique_ptr<MappedInput> input, std::size_t chunk_bytes)
+        : input(std::move(input)), buffer(chunk_bytes), ds(ZSTD_createDStream()) {
+        ZSTD_initDStream(ds);
+        in = { this->input->data(), this->input->size(), 0 };
+    }
+    ~ZstdStreamSource() override { ZSTD_freeDStream(ds); }
+
+    std::string describe() const override { return "zstd stream"; }
+    std::uint64_t file_size() const override { return input->size(); }
+
+    bool next(const char*& data, std::size_t& length) override {
+        ZSTD_outBuffer out{ buffer.data(), buffer.size(), 0 };
+        while (out.pos < out.size && in.pos < in.size) {
+            std::size_t status = ZSTD_decompressStream(ds, &out, &in);
+            if (ZSTD_isError(status)) {
+                throw std::runtime_error("Corrupt zstd stream in input file");
+            }
+        }
+        data = buffer.data();
+        length = out.pos;
+        return length > 0;
+    }
+
+private:
+    std::unique_ptr<MappedInput> input;
+    std::vector<char> buffer;
+    ZSTD_DStream* ds;
+    ZSTD_inBuffer in{};
+};
+#endif
+
+// Picks the chunk source for an input: plain files go through the read-ahead
+// pipeline, compressed ones are decompressed on the fly (in parallel when the
+// file is made of independent BGZF members or zstd frames).
+std::unique_ptr<ChunkSource> open_input(const std::string& path, const LoadOptions& opts, int threads) {
+    const Compression compression = detect_compression(path);
+    if (compression == Compression::none) {
+        return std::make_unique<ReadAheadFile>(path, opts);
+    }
+    auto input = std::make_unique<MappedInput>(path);
+    if (compression == Compression::gzip) {
+#if defined(SSSP_WITH_ZLIB)
+        auto members = bgzf_members(input->data(), input->size());
+        if (members.size() > 1) {
+            return std::make_unique<ParallelUnitSource>(std::move(input), std::move(members),
+                inflate_gzip_member, threads, "bgzf");
+        }
+        return std::make_unique<GzipStreamSource>(std::move(input), opts.chunk_bytes);
+#else
+        throw std::runtime_error("Input is gzip-compressed; rebuild with -DSSSP_WITH_ZLIB -lz");
+#endif
+    }
+#if defined(SSSP_WITH_ZSTD)
+    auto frames = zstd_frames(input->data(), input->size());
+    if (frames.size() > 1) {
+        return std::make_unique<ParallelUnitSource>(std::move(input), std::move(frames),
+            decompress_zstd_frame, threads, "zstd");
+    }
+    return std::make_unique<ZstdStreamSource>(std::move(input), opts.chunk_bytes);
+#else
+    (void)threads;
+    throw std::runtime_error("Input is zstd-compressed; rebuild with -DSSSP_WITH_ZSTD -lzstd");
+#endif
+}
+
+// Hands whole-line blocks to parser threads as the reader produces them and
+// keeps the parsed blocks in file order. The first error in file order wins.
+// With a header edge count and a known input size, each block reserves its
+// byte share of the edges.
+class ParallelBlockParser {
+public:
+    ParallelBlockParser(int threads, const InputLayout& layout, std::uint64_t text_bytes)
+        : layout(layout), text_bytes(text_bytes) {
+        for (int i = 0; i < threads; ++i) {
+            pool.emplace_back([this] { run(); });
+        }
+    }
+    ~ParallelBlockParser() { finish_workers(); }
+
+    // Queues a block; blocks while too many are waiting so memory stays bounded.
+    // `first_row` is the METIS vertex of the block's first row.
+    void add(std::string text, std::uint64_t first_row) {
+        std::unique_lock<std::mutex> lock(mutex);
+        space.wait(lock, [this] { return pending.size() < 2 * pool.size() + 2; });
+        std::size_t index = results.size();
+        results.emplace_back();
+        errors.emplace_back();
+        pending.push_back({ index, first_row, std::move(text) });
+        ready.notify_one();
+    }
+
+    std::vector<ParsedBlock> finish() {
+        finish_workers();
+        for (auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        return std::move(results);
+    }
+
+private:
+    struct Job {
+        std::size_t index;
+        std::uint64_t first_row;
+        std::string text;
+    };
+
+    const InputLayout layout;
+    const std::uint64_t text_bytes;
+    std::vector<std::thread> pool;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable space;
+    std::deque<Job> pending;
+    std::vector<ParsedBlock> results;
+    std::vector<std::exception_ptr> errors;
+    bool done = false;
+
+    void finish_workers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (done) {
+                return;
+            }
+            done = true;
+        }
+        ready.notify_all();
+        for (auto& t : pool) {
+            t.join();
+        }
+    }
+
+    void run() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return done || !pending.empty(); });
+                if (pending.empty()) {
+                    return;
+                }
+                job = std::move(pending.front());
+                pending.pop_front();
+            }
+            space.notify_one();
+            ParsedBlock block;
+            std::exception_ptr error;
+            try {
+                // Lines vary in length, so the share gets 1/16 headroom, but
+                // never more than the block can hold: every edge takes at
+                // least two bytes (a METIS neighbour, half a mirrored line).
+                if (layout.edges && text_bytes > 0) {
+                    const double share = static_cast<double>(*layout.edges) * static_cast<double>(job.text.size())
+                        / static_cast<double>(text_bytes);
+                    const double most = static_cast<double>(job.text.size() / 2 + 16);
+                    block.edges.reserve(static_cast<std::size_t>(std::min(share * 17 / 16 + 16, most)));
+                }
+                parse_input_lines(layout, job.text.data(), job.text.data() + job.text.size(), job.first_row, block);
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            results[job.index] = std::move(block);
+            errors[job.index] = error;
+        }
+    }
+};
+
+// Edges parsed from an input file, before they are assembled into a graph.
+struct ParsedInput {
+    std::vector<ParsedBlock> blocks;
+    std::size_t node_count = 0;
+    // Edge count from the header, when it declared one.
+    std::optional<std::uint64_t> declared_edges;
+    bool sorted_by_source = false;
+    std::chrono::steady_clock::time_point started;
+    // Everything but total_ms, which includes building the graph.
+    LoadReport report;
+};
+
+ParsedInput parse_graph_file(const std::string& path, const LoadOptions& opts) {
+    ParsedInput parsed;
+    parsed.started = std::chrono::steady_clock::now();
+    const int threads = opts.parser_threads > 0 ? opts.parser_threads
+        : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::unique_ptr<ChunkSource> input = open_input(path, opts, threads);
+
+    const char* data = nullptr;
+    std::size_t length = 0;
+    std::uint64_t input_bytes = 0;
+    std::chrono::duration<double, std::milli> io_wait{};
+    auto next_chunk = [&]() {
+        auto wait_start = std::chrono::steady_clock::now();
+        bool more = input->next(data, length);
+        io_wait += std::chrono::steady_clock::now() - wait_start;
+        input_bytes += more ? length : 0;
+        return more;
+    };
+
+    // Headers sit in the first lines; look at the first chunk (or 64 KiB)
+    // to pick the format and read them. Chunks end mid-line, so the rest
+    // is carried over to the first block.
+    std::string carry;
+    bool more = true;
+    while (carry.size() < (std::size_t{ 64 } << 10) && (more = next_chunk())) {
+        carry.append(data, length);
+    }
+    InputLayout layout;
+    layout.format = resolve_input_format(opts.format, path, carry);
+    layout.weight_scale = opts.weight_scale;
+    carry.erase(0, parse_input_header(carry, layout));
+    if (layout.edges && input->text_size() > 0 && *layout.edges > input->text_size() / 2) {
+        throw std::runtime_error(std::string(input_format_name(layout.format)) + " header declares "
+            + std::to_string(*layout.edges) + " edges, more than a " + std::to_string(input->text_size())
+            + "-byte input can hold");
+    }
+
+    ParallelBlockParser parser(threads, layout, input->text_size());
+    std::uint64_t next_row = 0;
+    auto dispatch = [&](std::string block) {
+        const std::uint64_t first_row = next_row;
+        if (layout.format == InputFormat::metis) {
+            next_row += count_metis_rows(block.data(), block.data() + block.size());
+        }
+        parser.add(std::move(block), first_row);
+    };
+    while (more && (more = next_chunk())) {
+        const char* last_newline = nullptr;
+        for (const char* p = data + length; p > data; --p) {
+            if (p[-1] == '\n') {
+                last_newline = p - 1;
+                break;
+            }
+        }
+        if (!last_newline) {
+            carry.append(data, length);
+            continue;
+        }
+        std::string block = std::move(carry);
+        block.append(data, last_newline + 1);
+        carry.assign(last_newline + 1, data + length);
+        dispatch(std::move(block));
+    }
+    if (!carry.empty()) {
+        dispatch(std::move(carry));
+    }
+    std::vector<ParsedBlock> blocks = parser.finish();
+
+    int max_node = -1;
+    for (const auto& block : blocks) {
+        max_node = std::max(max_node, block.max_node);
+    }
+    // A declared vertex count keeps trailing isolated vertices.
+    std::size_t node_count = layout.nodes ? static_cast<std::size_t>(*layout.nodes)
+                                          : static_cast<std::size_t>(max_node + 1);
+    if (layout.min_nodes && max_node >= 0) {
+        node_count = std::max(node_count, static_cast<std::size_t>(*layout.min_nodes));
+    }
+    if (layout.metadata_header && layout.edges) {
+        std::uint64_t total = 0;
+        for (const auto& block : blocks) {
+            total += block.edges.size();
+        }
+        if (total != *layout.edges) {
+            throw std::runtime_error("Header declares " + std::to_string(*layout.edges)
+                + " edges but the file has " + std::to_string(total));
+        }
+    }
+    parsed.blocks = std::move(blocks);
+    parsed.node_count = node_count;
+    parsed.declared_edges = layout.edges;
+    parsed.sorted_by_source = layout.sorted_by_source;
+    parsed.report.format = input_format_name(layout.format);
+    parsed.report.io_backend = input->describe();
+    parsed.report.parser_threads = threads;
+    parsed.report.bytes = input->file_size();
+    parsed.report.decoded_bytes = input_bytes;
+    parsed.report.io_wait_ms = io_wait.count();
+    return parsed;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+GraphLoadResult read_graph_from_file(const std::string& path, const LoadOptions& opts = {}) {
+    ParsedInput parsed = parse_graph_file(path, opts);
+    GraphLoadResult result;
+    if (parsed.node_count > 0) {
+        std::optional<Graph> grouped;
+        if (parsed.sorted_by_source) {
+            grouped = build_csr_grouped(parsed.node_count, parsed.blocks, parsed.declared_edges);
+        }
+        result.graph = grouped ? std::move(*grouped) : build_csr(parsed.node_count, parsed.blocks);
+        result.node_count = static_cast<int>(parsed.node_count);
+    }
+    result.report = parsed.report;
+    result.report.total_ms = elapsed_ms(parsed.started);
+    return result;
+}
+
+// Header of a published graph segment. The CSR offsets (node_count + 1
+// words) and the edge array follow at cache-line aligned byte offsets.
+struct SharedGraphHeader {
+    char magic[8];
+    std::uint64_t edge_size;
+    std::uint64_t node_count;
+    std::uint64_t edge_count;
+    std::uint64_t offsets_at;
+    std::uint64_t edges_at;
+    std::uint64_t total_bytes;
+    std::uint64_t flags;
+};
+
+constexpr char kSharedGraphMagic[8] = { 'S', 'S', 'S', 'P', 'C', 'S', 'R', '1' };
+constexpr std::uint64_t kSharedGraphRowsSorted = 1;
+
+// "shm:/name" names a POSIX shared-memory object, "mmap:path" a regular file
+// that is mapped with mmap. Anything else is an edge-list text file.
+struct SharedGraphLocation {
+    bool posix_shm;
+    std::string name;
+};
+
+std::optional<SharedGraphLocation> parse_shared_graph_spec(const std::string& spec) {
+    if (spec.rfind("shm:", 0) == 0) {
+        std::string name = spec.substr(4);
+        if (name.size() < 2 || name[0] != '/' || name.find('/', 1) != std::string::npos) {
+            throw std::runtime_error("Shared-memory names look like shm:/name: " + spec);
+        }
+        return SharedGraphLocation{ true, name };
+    }
+    if (spec.rfind("mmap:", 0) == 0) {
+        return SharedGraphLocation{ false, spec.substr(5) };
+    }
+    return std::nullopt;
+}
+
+#if defined(__unix__)
+// Copies a graph into a named segment that other processes can attach to.
+// The segment is written under a temporary name and renamed into place, so
+// a failed publish leaves any existing segment untouched and removes its
+// own partial copy; processes still mapping a replaced segment keep it
+// until they detach. POSIX shm objects are renamed through /dev/shm on
+// Linux; elsewhere the old object has to be unlinked before the new one is
+// created under its name.
+std::size_t publish_graph(const Graph& graph, bool rows_sorted, const std::string& spec) {
+    auto location = parse_shared_graph_spec(spec);
+    if (!location) {
+        throw std::runtime_error("Publish target must be shm:/name or mmap:path: " + spec);
+    }
+
+    auto align_line = [](std::uint64_t offset) {
+        return (offset + kCacheLineBytes - 1) / kCacheLineBytes * kCacheLineBytes;
+    };
+    SharedGraphHeader header{};
+    header.edge_size = sizeof(Edge);
+    header.node_count = graph.size();
+    header.edge_count = graph.edge_count();
+    header.offsets_at = align_line(sizeof(SharedGraphHeader));
+    header.edges_at = align_line(header.offsets_at + (header.node_count + 1) * sizeof(std::uint64_t));
+    header.total_bytes = header.edges_at + header.edge_count * sizeof(Edge);
+    header.flags = rows_sorted ? kSharedGraphRowsSorted : 0;
+
+#if defined(__linux__)
+    const bool in_place = false;
+#else
+    const bool in_place = location->posix_shm;
+#endif
+    // The pid keeps concurrent publishers of one name apart.
+    const std::string temp_name = in_place ? location->name
+                                           : location->name + ".tmp." + std::to_string(getpid());
+    int fd;
+    if (location->posix_shm) {
+        if (in_place) {
+            shm_unlink(temp_name.c_str());
+        }
+        fd = shm_open(temp_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    else {
+        fd = open(temp_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create graph segment: " + spec);
+    }
+    auto discard = [&](const std::string& what) {
+        if (location->posix_shm) {
+            shm_unlink(temp_name.c_str());
+        }
+        else {
+            unlink(temp_name.c_str());
+        }
+        return std::runtime_error(what + spec);
+    };
+    // Space is allocated up front: on tmpfs a sparse segment would turn
+    // running out of memory into SIGBUS inside the copy below.
+    if (posix_fallocate(fd, 0, static_cast<off_t>(header.total_bytes)) != 0) {
+        close(fd);
+        throw discard("Not enough space for graph segment: ");
+    }
+    void* mem = mmap(nullptr, header.total_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        throw discard("Failed to map graph segment: ");
+    }
+
+    auto* base = static_cast<char*>(mem);
+    std::memcpy(base + header.offsets_at, graph.offsets(),
+        (header.node_count + 1) * sizeof(std::uint64_t));
+    if (header.edge_count > 0) {
+        std::memcpy(base + header.edges_at, graph.edges(), header.edge_count * sizeof(Edge));
+    }
+    // The magic goes in last so a half-written segment never validates.
+    std::memcpy(base, &header, sizeof(header));
+    std::memcpy(base, kSharedGraphMagic, sizeof(kSharedGraphMagic));
+    munmap(mem, header.total_bytes);
+
+    if (!in_place) {
+        const std::string from = location->posix_shm ? "/dev/shm" + temp_name : temp_name;
+        const std::string to = location->posix_shm ? "/dev/shm" + location->name : location->name;
+        if (std::rename(from.c_str(), to.c_str()) != 0) {
+            throw discard("Failed to move graph segment into place: ");
+        }
+    }
+    return header.total_bytes;
+}
+
+// Maps a published segment read-only. The returned graph borrows the mapped
+// arrays, so every attached process shares one physical copy.
+GraphLoadResult attach_graph(const std::string& spec) {
+    auto location = parse_shared_graph_spec(spec);
+    if (!location) {
+        throw std::runtime_error("Not a graph segment spec: " + spec);
+    }
+    int fd = location->posix_shm ? shm_open(location->name.c_str(), O_RDONLY, 0)
+                                 : open(location->name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open graph segment: " + spec);
+    }
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(SharedGraphHeader)) {
+        close(fd);
+        throw std::runtime_error("Graph segment is too small: " + spec);
+    }
+    const auto bytes = static_cast<std::size_t>(info.st_size);
+    void* mem = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        throw std::runtime_error("Failed to map graph segment: " + spec);
+    }
+    std::shared_ptr<const void> mapping(mem, [bytes](const void* p) {
+        munmap(const_cast<void*>(p), bytes);
+    });
+
+    SharedGraphHeader header;
+    std::memcpy(&header, mem, sizeof(header));
+    if (std::memcmp(header.magic, kSharedGraphMagic, sizeof(kSharedGraphMagic)) != 0
+        || header.edge_size != sizeof(Edge) || header.total_bytes > bytes
+        || header.node_count > static_cast<std::uint64_t>(std::numeric_limits<int>::max())) {
+        throw std::runtime_error("Not a compatible graph segment: " + spec);
+    }
+
+    // A stale or truncated segment must not lead to reads past the mapping:
+    // both arrays have to lie after the header and inside total_bytes, the
+    // offsets must climb from 0 to edge_count, and every target must be a
+    // vertex.
+    const std::uint64_t offset_bytes = (header.node_count + 1) * sizeof(std::uint64_t);
+    auto region_fits = [&](std::uint64_t at, std::uint64_t count, std::uint64_t size, std::uint64_t align) {
+        return at >= sizeof(SharedGraphHeader) && at % align == 0 && at <= header.total_bytes
+            && count <= (header.total_bytes - at) / size;
+    };
+    if (!region_fits(header.offsets_at, header.node_count + 1, sizeof(std::uint64_t), alignof(std::uint64_t))
+        || !region_fits(header.edges_at, header.edge_count, sizeof(Edge), alignof(Edge))
+        || (header.edges_at < header.offsets_at + offset_bytes
+            && header.offsets_at < header.edges_at + header.edge_count * sizeof(Edge))) {
+        throw std::runtime_error("Graph segment layout is out of bounds: " + spec);
+    }
+    const auto* base = static_cast<const char*>(mem);
+    const auto* offsets = reinterpret_cast<const std::uint64_t*>(base + header.offsets_at);
+    const auto* edges = reinterpret_cast<const Edge*>(base + header.edges_at);
+    if (offsets[0] != 0 || offsets[header.node_count] != header.edge_count
+        || !std::is_sorted(offsets, offsets + header.node_count + 1)) {
+        throw std::runtime_error("Graph segment has corrupt row offsets: " + spec);
+    }
+    for (std::uint64_t i = 0; i < header.edge_count; ++i) {
+        if (edges[i].to < 0 || static_cast<std::uint64_t>(edges[i].to) >= header.node_count) {
+            throw std::runtime_error("Graph segment has an edge to a missing vertex: " + spec);
+        }
+    }
+
+    GraphLoadResult result;
+    result.graph = Graph::borrowed(offsets, edges, static_cast<std::size_t>(header.node_count), std::move(mapping));
+    result.node_count = static_cast<int>(header.node_count);
+    result.rows_sorted_by_weight = (header.flags & kSharedGraphRowsSorted) != 0;
+    return result;
+}
+
+// Out-of-core CSR: scatters the parsed edges straight into a file-backed
+// mapping in the segment format and attaches it, so the edge array lives in
+// reclaimable page cache instead of anonymous memory. The file (under
+// $TMPDIR) is unlinked once attached. The attached graph is read-only, so
+// rows that should be ordered by weight are sorted before attaching.
+GraphLoadResult spill_csr(std::size_t node_count, const std::vector<ParsedBlock>& blocks, bool sort_rows) {
+    std::vector<std::uint64_t> offsets = csr_offsets<std::uint64_t>(node_count, blocks);
+    auto align_line = [](std::uint64_t offset) {
+        return (offset + kCacheLineBytes - 1) / kCacheLineBytes * kCacheLineBytes;
+    };
+    SharedGraphHeader header{};
+    header.edge_size = sizeof(Edge);
+    header.node_count = node_count;
+    header.edge_count = offsets.back();
+    header.offsets_at = align_line(sizeof(SharedGraphHeader));
+    header.edges_at = align_line(header.offsets_at + (node_count + 1) * sizeof(std::uint64_t));
+    header.total_bytes = header.edges_at + header.edge_count * sizeof(Edge);
+    header.flags = sort_rows ? kSharedGraphRowsSorted : 0;
+
+    const char* dir = std::getenv("TMPDIR");
+    std::string path = std::string(dir && *dir ? dir : "/tmp") + "/sssp-csr-XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create out-of-core graph file: " + path);
+    }
+    if (ftruncate(fd, static_cast<off_t>(header.total_bytes)) != 0) {
+        close(fd);
+        unlink(path.c_str());
+        throw std::runtime_error("Failed to size out-of-core graph file: " + path);
+    }
+    void* mem = mmap(nullptr, header.total_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        unlink(path.c_str());
+        throw std::runtime_error("Failed to map out-of-core graph file: " + path);
+    }
+    auto* base = static_cast<char*>(mem);
+    std::memcpy(base + header.offsets_at, offsets.data(), offsets.size() * sizeof(std::uint64_t));
+    scatter_csr(offsets, blocks, reinterpret_cast<Edge*>(base + header.edges_at));
+    if (sort_rows) {
+        sort_rows_by_weight(offsets.data(), reinterpret_cast<Edge*>(base + header.edges_at), node_count);
+    }
+    std::memcpy(base, &header, sizeof(header));
+    std::memcpy(base, kSharedGraphMagic, sizeof(kSharedGraphMagic));
+    munmap(mem, header.total_bytes);
+
+    GraphLoadResult result;
+    try {
+        result = attach_graph("mmap:" + path);
+    }
+    catch (...) {
+        unlink(path.c_str());
+        throw;
+    }
+    unlink(path.c_str());
+    return result;
+}
+
+// Resident set size now, or 0 where it cannot be read.
+std::uint64_t current_rss_bytes() {
+#if defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    std::uint64_t pages = 0, resident = 0;
+    if (statm >> pages >> resident) {
+        return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
+
+// Highest resident set size so far.
+std::uint64_t peak_rss_bytes() {
+    struct rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+}
+#else
+std::size_t publish_graph(const Graph&, bool, const std::string&) {
+    throw std::runtime_error("Graph segments need POSIX shared memory");
+}
+
+GraphLoadResult attach_graph(const std::string&) {
+    throw std::runtime_error("Graph segments need POSIX shared memory");
+}
+
+GraphLoadResult spill_csr(std::size_t, const std::vector<ParsedBlock>&, bool) {
+    throw std::runtime_error("Out-of-core graphs need POSIX mmap");
+}
+
+std::uint64_t current_rss_bytes() {
+    return 0;
+}
+
+std::uint64_t peak_rss_bytes() {
+    return 0;
+}
+#endif
+
+// Reads one coordinate per vertex. DIMACS .co files give 'v id x y' with
+// 1-based ids (and 'c'/'p' lines); plain 'id x y' lines are zero-based like
+// the edge list. Every vertex must have a coordinate. The file goes through
+// the same chunked reader as edge input.
+std::vector<Coordinate> read_coordinates(const std::string& path, std::size_t node_count,
+    const LoadOptions& opts) {
+    std::unique_ptr<ChunkSource> input = open_input(path, opts, 1);
+    std::vector<Coordinate> coords(node_count);
+    std::vector<bool> seen(node_count, false);
+    std::size_t count = 0;
+    auto parse_real = [](const char*& p, const char* eol, double& value) {
+        skip_blanks(p, eol);
+        char* stop = nullptr;
+        // strtod would skip a newline and read the next line's value.
+        value = p < eol ? std::strtod(p, &stop) : 0.0;
+        if (stop == nullptr || stop == p || stop > eol) {
+            return false;
+        }
+        p = stop;
+        return true;
+    };
+    auto parse_line = [&](const char* line, const char* eol) {
+        const char* p = line;
+        skip_blanks(p, eol);
+        if (p == eol || *p == '#' || *p == 'c' || *p == 'p') {
+            return;
+        }
+        long long id = -1;
+        bool ok;
+        if (*p == 'v') {
+            ++p;
+            skip_blanks(p, eol);
+            ok = parse_integer(p, eol, id);
+            --id;
+        }
+        else {
+            ok = parse_integer(p, eol, id);
+        }
+        Coordinate c;
+        ok = ok && parse_real(p, eol, c.x) && parse_real(p, eol, c.y);
+        skip_blanks(p, eol);
+        if (!ok || p != eol) {
+            throw std::runtime_error("Invalid line in coordinate file: " + std::string(line, eol));
+        }
+        // strtod also takes "nan" and "inf", which no potential can use.
+        if (!std::isfinite(c.x) || !std::isfinite(c.y)) {
+            throw std::runtime_error("Non-finite coordinate in coordinate file: " + std::string(line, eol));
+        }
+        if (id < 0 || static_cast<std::uint64_t>(id) >= node_count) {
+            throw std::runtime_error("Coordinate for a vertex outside the graph: " + std::string(line, eol));
+        }
+        if (!seen[static_cast<std::size_t>(id)]) {
+            seen[static_cast<std::size_t>(id)] = true;
+            ++count;
+        }
+        coords[static_cast<std::size_t>(id)] = c;
+    };
+
+    // Whole lines are parsed in place; a line split across chunks is
+    // finished in `carry`.
+    std::string carry;
+    const char* data = nullptr;
+    std::size_t length = 0;
+    while (input->next(data, length)) {
+        const char* end = data + length;
+        const char* body = data;
+        if (!carry.empty()) {
+            const char* eol = static_cast<const char*>(std::memchr(data, '\n', length));
+            if (!eol) {
+                carry.append(data, length);
+                continue;
+            }
+            carry.append(data, eol);
+            parse_line(carry.data(), carry.data() + carry.size());
+            carry.clear();
+            body = eol + 1;
+        }
+        const char* tail = end;
+        while (tail > body && tail[-1] != '\n') {
+            --tail;
+        }
+        for_each_line(body, tail, parse_line);
+        carry.assign(tail, end);
+    }
+    if (!carry.empty()) {
+        parse_line(carry.data(), carry.data() + carry.size());
+    }
+    if (count != node_count) {
+        throw std::runtime_error("Coordinate file covers " + std::to_string(count) + " of "
+            + std::to_string(node_count) + " vertices");
+    }
+    return coords;
+}
+
+const char* representation_name(Representation kind) {
+    switch (kind) {
+    case Representation::narrow_csr: return "narrow CSR";
+    case Representation::adjacency_lists: return "adjacency lists";
+    case Representation::compressed: return "compressed";
+    case Representation::out_of_core: return "out-of-core CSR";
+    default: return "CSR";
+    }
+}
+
+std::uint64_t varint_bytes(std::uint64_t value) {
+    std::uint64_t bytes = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++bytes;
+    }
+    return bytes;
+}
+
+// Projects the resident peak of every layout for the parsed graph and picks
+// the fastest whose peak fits `limit`. The peak is the larger of building
+// the layout (parsed edges still held) and querying it (parsed edges freed,
+// engine working memory added), on top of what the process holds now.
+MemoryPlan plan_representation(const ParsedInput& parsed, std::uint64_t limit, bool compact_allowed) {
+    const std::uint64_t n = parsed.node_count;
+    std::uint64_t m = 0, max_weight = 0, weight_sum = 0, parsed_bytes = 0;
+    for (const auto& block : parsed.blocks) {
+        m += block.edges.size();
+        parsed_bytes += block.edges.capacity() * sizeof(ParsedEdge);
+        for (const auto& e : block.edges) {
+            max_weight = std::max(max_weight, e.weight);
+            weight_sum += e.weight;
+        }
+    }
+    MemoryPlan plan;
+    plan.limit = limit;
+    plan.parsed_bytes = parsed_bytes;
+    plan.base_bytes = std::max(current_rss_bytes(), parsed_bytes);
+    plan.parse_peak_bytes = std::max(peak_rss_bytes(), plan.base_bytes);
+    // dist, settled bits, about one heap entry per vertex, and the two
+    // distance vectors the benchmark keeps for verification.
+    plan.working_bytes = n * sizeof(std::uint64_t) + n / 8 + n * 16 + 2 * n * sizeof(std::uint64_t);
+
+    const std::uint64_t base = plan.base_bytes;
+    const std::uint64_t after_parse = base - parsed_bytes;
+    auto estimate = [&](Representation kind, std::uint64_t graph_bytes, std::uint64_t build_peak,
+                        std::uint64_t resident_graph) {
+        RepresentationEstimate e;
+        e.kind = kind;
+        e.graph_bytes = graph_bytes;
+        e.peak_bytes = std::max({ plan.parse_peak_bytes, build_peak, after_parse + resident_graph + plan.working_bytes });
+        return e;
+    };
+    const std::uint64_t csr = 8 * (n + 1) + sizeof(Edge) * m;
+    const std::uint64_t narrow = 4 * (n + 1) + sizeof(NarrowEdge) * m;
+    plan.narrow_fits = m < (std::uint64_t{ 1 } << 32) && max_weight < (std::uint64_t{ 1 } << 32);
+    // Gaps between sorted neighbours average n / degree; weights their mean.
+    const std::uint64_t avg_degree = std::max<std::uint64_t>(1, n ? m / n : 1);
+    const std::uint64_t compressed = 8 * (n + 1)
+        + m * (varint_bytes(n / avg_degree) + varint_bytes(m ? weight_sum / m : 0));
+    // Compressed rows are encoded from a staging CSR once the parsed edges are freed.
+    const std::uint64_t staging = plan.narrow_fits ? narrow : csr;
+    const std::uint64_t staging_cursor = plan.narrow_fits ? 4 * n : 8 * n;
+
+    plan.estimates.push_back(estimate(Representation::csr, csr, base + csr + 8 * n, csr));
+    plan.estimates.push_back(estimate(Representation::narrow_csr, narrow, base + narrow + 4 * n, narrow));
+    plan.estimates.back().applicable = plan.narrow_fits && compact_allowed;
+    // One vector per vertex: 24-byte header plus an exactly sized row. Never
+    // chosen: larger than CSR and slower to scan.
+    const std::uint64_t lists = 24 * n + sizeof(Edge) * m;
+    plan.estimates.push_back(estimate(Representation::adjacency_lists, lists, base + lists, lists));
+    plan.estimates.back().applicable = false;
+    plan.estimates.push_back(estimate(Representation::compressed, compressed,
+        std::max(base + staging + staging_cursor, after_parse + staging + compressed), compressed));
+    plan.estimates.back().applicable = compact_allowed;
+    // Only the offsets stay hot; edges are paged in from the file.
+    plan.estimates.push_back(estimate(Representation::out_of_core, csr, base + 16 * n, 8 * (n + 1)));
+
+    plan.chosen = Representation::out_of_core;
+    plan.projected_peak = plan.estimates.back().peak_bytes;
+    for (const auto& e : plan.estimates) {
+        if (e.applicable && e.peak_bytes <= limit) {
+            plan.chosen = e.kind;
+            plan.projected_peak = e.peak_bytes;
+            break;
+        }
+    }
+    return plan;
+}
+
+// Attaches to a published segment or parses an input file. With a memory
+// budget the parsed edges go into the layout plan_representation picks.
+GraphLoadResult load_graph(const std::string& spec, const LoadOptions& opts = {}) {
+    GraphLoadResult result;
+    if (parse_shared_graph_spec(spec)) {
+        result = attach_graph(spec);
+    }
+    else if (opts.mem_limit == 0) {
+        result = read_graph_from_file(spec, opts);
+    }
+    else {
+        ParsedInput parsed = parse_graph_file(spec, opts);
+        MemoryPlan plan = plan_representation(parsed, opts.mem_limit, opts.compact_representations);
+        const std::size_t n = parsed.node_count;
+        switch (plan.chosen) {
+        case Representation::narrow_csr:
+            result.narrow = build_narrow_csr(n, parsed.blocks);
+            plan.actual_graph_bytes = result.narrow.bytes();
+            break;
+        case Representation::compressed:
+            // Encode from the smaller staging CSR, freeing the parsed edges first.
+            if (plan.narrow_fits) {
+                NarrowGraph staging = build_narrow_csr(n, parsed.blocks);
+                parsed.blocks = {};
+                result.compressed = CompressedGraph::encode(staging);
+            }
+            else {
+                Graph staging = build_csr(n, parsed.blocks);
+                parsed.blocks = {};
+                result.compressed = CompressedGraph::encode(staging);
+            }
+            plan.actual_graph_bytes = result.compressed.bytes();
+            break;
+        case Representation::out_of_core:
+            result = spill_csr(n, parsed.blocks, opts.sort_rows);
+            plan.actual_graph_bytes = 8 * (n + 1) + sizeof(Edge) * result.graph.edge_count();
+            break;
+        default:
+            result.graph = build_csr(n, parsed.blocks);
+            plan.actual_graph_bytes = 8 * (n + 1) + sizeof(Edge) * result.graph.edge_count();
+            break;
+        }
+        result.node_count = static_cast<int>(n);
+        result.representation = plan.chosen;
+        result.memory_plan = plan;
+        result.report = parsed.report;
+        result.report.total_ms = elapsed_ms(parsed.started);
+    }
+    if (!opts.coords_path.empty()) {
+        result.coordinates = read_coordinates(opts.coords_path, static_cast<std::size_t>(result.node_count), opts);
+    }
+    return result;
+}
+
+// One bit per vertex marking it settled. Kept apart from the distance array
+// so stale heap entries are rejected from a dense array (n/8 bytes,
+// L2-resident for tens of millions of vertices) without loading dist[].
+// Relaxations deliberately do not consult it: an edge into a settled vertex
+// already fails nd < dist[v], and the extra per-edge test measured slower.
+class SettledBitmap {
+public:
+    explicit SettledBitmap(std::size_t n) : words((n + 63) / 64, 0) {}
+
+    bool test(std::size_t v) const { return (words[v >> 6] >> (v & 63)) & 1; }
+    void set(std::size_t v) { words[v >> 6] |= std::uint64_t{ 1 } << (v & 63); }
+    void reset(std::size_t v) { words[v >> 6] &= ~(std::uint64_t{ 1 } << (v & 63)); }
+
+private:
+    std::vector<std::uint64_t> words;
+};
+
+// Operation counts gathered by the lazy SSSP loop.
+struct SsspCounters {
+    std::uint64_t pops = 0;
+    std::uint64_t stale_pops = 0;
+    std::uint64_t relaxations = 0;
+    std::uint64_t improvements = 0;
+    // Edges never examined because a weight-sorted row was cut off by the bound.
+    std::uint64_t pruned_edges = 0;
+};
+
+// Lazy-insertion Dijkstra shared by all engines; Queue provides
+// push(key, vertex), pop() -> (key, vertex) and empty(). G is Graph or any
+// layout whose rows yield edges with `to` and `weight`. This overload runs
+// on a caller-owned queue so its own statistics can be read afterwards.
+template <typename Queue, typename G = Graph>
+std::vector<std::uint64_t> lazy_sssp(const G& graph, int source, Queue& pq,
+    SsspCounters* counters = nullptr) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    std::vector<std::uint64_t> dist(graph.size(), INF);
+    dist[source] = 0;
+    SettledBitmap settled(graph.size());
+    SsspCounters local;
+
+    pq.push(0, source);
+
+    while (!pq.empty()) {
+        auto [d, u] = pq.pop();
+        ++local.pops;
+        if (settled.test(static_cast<std::size_t>(u))) {
+            ++local.stale_pops;
+            continue;
+        }
+        settled.set(static_cast<std::size_t>(u));
+        for (const auto& edge : graph[u]) {
+            ++local.relaxations;
+            std::uint64_t nd = d + edge.weight;
+            if (nd < dist[edge.to]) {
+                dist[edge.to] = nd;
+                pq.push(nd, edge.to);
+                ++local.improvements;
+            }
+        }
+    }
+
+    if (counters) {
+        *counters = local;
+    }
+    return dist;
+}
+
+template <typename Queue, typename G = Graph>
+std::vector<std::uint64_t> lazy_sssp(const G& graph, int source,
+    SsspCounters* counters = nullptr) {
+    Queue pq;
+    return lazy_sssp(graph, source, pq, counters);
+}
+
+// std::priority_queue behind the push/pop interface used by lazy_sssp.
+class BinaryHeap {
+public:
+    bool empty() const { return pq.empty(); }
+    std::size_t size() const { return pq.size(); }
+
+    void push(std::uint64_t key, int value) { pq.push({ key, value }); }
+
+    std::pair<std::uint64_t, int> pop() {
+        auto res = pq.top();
+        pq.pop();
+        return res;
+    }
+
+private:
+    using P = std::pair<std::uint64_t, int>;
+    std::priority_queue<P, std::vector<P>, std::greater<P>> pq;
+};
+
+// Dijkstra using binary heap priority_queue.
+std::vector<std::uint64_t> dijkstra(const Graph& graph, int source) {
+    return lazy_sssp<BinaryHeap>(graph, source);
+}
+
+// Radix heap implementation for 64-bit unsigned keys.
+class RadixHeap {
+public:
+    RadixHeap() : buckets(65), last(0), sz(0) {}
+
+    bool empty() const { return sz == 0; }
+    std::size_t size() const { return sz; }
+    // Buckets redistributed, and entries moved by those redistributions.
+    std::uint64_t relocations() const { return relocation_count; }
+    std::uint64_t relocated_entries() const { return relocated_count; }
+
+    void push(std::uint64_t key, int value) {
+        std::size_t idx = bucket_index(key ^ last);
+        buckets[idx].emplace_back(key, value);
+        ++sz;
+    }
+
+    std::pair<std::uint64_t, int> pop() {
+        if (buckets[0].empty()) {
+            relocate();
+        }
+        auto res = buckets[0].back();
+        buckets[0].pop_back();
+        --sz;
+        return res;
+    }
+
+private:
+    std::vector<std::vector<std::pair<std::uint64_t, int>>> buckets;
+    std::uint64_t last;
+    std::size_t sz;
+    std::uint64_t relocation_count = 0;
+    std::uint64_t relocated_count = 0;
+
+    static std::size_t bucket_index(std::uint64_t diff) {
+        if (diff == 0) {
+            return 0;
+        }
+        return 64 - static_cast<std::size_t>(__builtin_clzll(diff));
+    }
+
+    void relocate() {
+        std::size_t i = 1;
+        while (i < buckets.size() && buckets[i].empty()) {
+            ++i;
+        }
+        if (i == buckets.size()) {
+            throw std::logic_error("RadixHeap is empty");
+        }
+        ++relocation_count;
+        relocated_count += buckets[i].size();
+
+        auto new_last = buckets[i][0].first;
+        for (const auto& item : buckets[i]) {
+            if (item.first < new_last) {
+                new_last = item.first;
+            }
+        }
+        last = new_last;
+
+        for (const auto& item : buckets[i]) {
+            std::size_t idx = bucket_index(item.first ^ last);
+            buckets[idx].push_back(item);
+        }
+        buckets[i].clear();
+    }
+};
+
+std::vector<std::uint64_t> breaking_sorting_barrier_sssp(const Graph& graph, int source) {
+    return lazy_sssp<RadixHeap>(graph, source);
+}
+
+// Radix heap with one entry per vertex. Each queued vertex keeps a
+// (bucket, slot) handle, so decrease-key moves its entry to the bucket for
+// the new key (or rewrites it in place when the bucket does not change)
+// and removal swaps the bucket's last entry into the hole. The heap never
+// holds more than n entries and pops are never stale.
+class IndexedRadixHeap {
+public:
+    explicit IndexedRadixHeap(std::size_t n) : buckets(65), handles(n), last(0), sz(0), peak(0) {}
+
+    bool empty() const { return sz == 0; }
+    std::size_t size() const { return sz; }
+    // Largest number of entries held at once.
+    std::size_t peak_size() const { return peak; }
+
+    // Inserts `value`, or lowers its key if it is already queued. The key
+    // must not be above the current one nor below the last popped key.
+    void push_or_decrease(std::uint64_t key, int value) {
+        Handle& h = handles[static_cast<std::size_t>(value)];
+        std::size_t idx = bucket_index(key ^ last);
+        if (h.bucket != kAbsent) {
+            if (h.bucket == idx) {
+                buckets[idx][h.slot].first = key;
+                return;
+            }
+            remove(h);
+        }
+        else {
+            ++sz;
+            peak = std::max(peak, sz);
+        }
+        place(key, value, idx);
+    }
+
+    std::pair<std::uint64_t, int> pop() {
+        if (buckets[0].empty()) {
+            relocate();
+        }
+        auto res = buckets[0].back();
+        buckets[0].pop_back();
+        handles[static_cast<std::size_t>(res.second)].bucket = kAbsent;
+        --sz;
+        return res;
+    }
+
+private:
+    static constexpr std::uint8_t kAbsent = 0xFF;
+
+    struct Handle {
+        std::uint32_t slot = 0;
+        std::uint8_t bucket = kAbsent;
+    };
+
+    std::vector<std::vector<std::pair<std::uint64_t, int>>> buckets;
+    std::vector<Handle> handles;
+    std::uint64_t last;
+    std::size_t sz;
+    std::size_t peak;
+
+    static std::size_t bucket_index(std::uint64_t diff) {
+        if (diff == 0) {
+            return 0;
+        }
+        return 64 - static_cast<std::size_t>(__builtin_clzll(diff));
+    }
+
+    void place(std::uint64_t key, int value, std::size_t idx) {
+        Handle& h = handles[static_cast<std::size_t>(value)];
+        h.bucket = static_cast<std::uint8_t>(idx);
+        h.slot = static_cast<std::uint32_t>(buckets[idx].size());
+        buckets[idx].emplace_back(key, value);
+    }
+
+    // Swap-remove; the caller re-places or forgets the vertex.
+    void remove(const Handle& h) {
+        auto& bucket = buckets[h.bucket];
+        if (h.slot + 1 != bucket.size()) {
+            bucket[h.slot] = bucket.back();
+            handles[static_cast<std::size_t>(bucket[h.slot].second)].slot = h.slot;
+        }
+        bucket.pop_back();
+    }
+
+    void relocate() {
+        std::size_t i = 1;
+        while (i < buckets.size() && buckets[i].empty()) {
+            ++i;
+        }
+        if (i == buckets.size()) {
+            throw std::logic_error("IndexedRadixHeap is empty");
+        }
+
+        auto new_last = buckets[i][0].first;
+        for (const auto& item : buckets[i]) {
+            if (item.first < new_last) {
+                new_last = item.first;
+            }
+        }
+        last = new_last;
+
+        std::vector<std::pair<std::uint64_t, int>> moving;
+        moving.swap(buckets[i]);
+        for (const auto& item : moving) {
+            place(item.first, item.second, bucket_index(item.first ^ last));
+        }
+        // Hand the storage back so the bucket does not reallocate next time.
+        moving.clear();
+        buckets[i].swap(moving);
+    }
+};
+
+// Dijkstra over IndexedRadixHeap. Improvements lower the queued key instead
+// of pushing a duplicate, so every pop settles a vertex; `peak_entries`
+// receives the largest heap size seen.
+std::vector<std::uint64_t> radix_decrease_key_sssp(const Graph& graph, int source,
+    SsspCounters* counters = nullptr, std::size_t* peak_entries = nullptr) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    std::vector<std::uint64_t> dist(graph.size(), INF);
+    dist[source] = 0;
+    SsspCounters local;
+
+    IndexedRadixHeap pq(graph.size());
+    pq.push_or_decrease(0, source);
+
+    while (!pq.empty()) {
+        auto [d, u] = pq.pop();
+        ++local.pops;
+        for (const auto& edge : graph[u]) {
+            ++local.relaxations;
+            std::uint64_t nd = d + edge.weight;
+            if (nd < dist[edge.to]) {
+                dist[edge.to] = nd;
+                pq.push_or_decrease(nd, edge.to);
+                ++local.improvements;
+            }
+        }
+    }
+
+    if (counters) {
+        *counters = local;
+    }
+    if (peak_entries) {
+        *peak_entries = pq.peak_size();
+    }
+    return dist;
+}
+
+// Open-addressing map from 64-bit keys to 32-bit indices (linear probing,
+// backward-shift deletion), kept as two flat arrays so a probe touches one
+// or two cache lines.
+class KeyIndexTable {
+public:
+    static constexpr std::uint32_t kNone = std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t* find(std::uint64_t key) {
+        if (keys.empty()) {
+            return nullptr;
+        }
+        for (std::size_t i = home(key);; i = (i + 1) & mask) {
+            if (values[i] == kNone) {
+                return nullptr;
+            }
+            if (keys[i] == key) {
+                return &values[i];
+            }
+        }
+    }
+
+    // Inserts key -> value unless the key is present. Returns the stored
+    // value's slot and whether it was inserted; the slot is valid until the
+    // next insertion.
+    std::pair<std::uint32_t*, bool> insert(std::uint64_t key, std::uint32_t value) {
+        if (2 * (count + 1) > keys.size()) {
+            grow();
+        }
+        std::size_t i = home(key);
+        for (; values[i] != kNone; i = (i + 1) & mask) {
+            if (keys[i] == key) {
+                return { &values[i], false };
+            }
+        }
+        keys[i] = key;
+        values[i] = value;
+        ++count;
+        return { &values[i], true };
+    }
+
+    // Removes a key that must be present and returns its value.
+    std::uint32_t erase(std::uint64_t key) {
+        std::size_t i = home(key);
+        while (keys[i] != key || values[i] == kNone) {
+            i = (i + 1) & mask;
+        }
+        const std::uint32_t value = values[i];
+        // Pull later entries of the probe run back over the hole.
+        for (std::size_t j = (i + 1) & mask; values[j] != kNone; j = (j + 1) & mask) {
+            const std::size_t h = home(keys[j]);
+            if (((j - h) & mask) >= ((j - i) & mask)) {
+                keys[i] = keys[j];
+                values[i] = values[j];
+                i = j;
+            }
+        }
+        values[i] = kNone;
+        --count;
+        return value;
+    }
+
+private:
+    std::vector<std::uint64_t> keys;
+    std::vector<std::uint32_t> values;
+    std::size_t mask = 0;
+    std::size_t count = 0;
+    int shift = 64;
+
+    std::size_t home(std::uint64_t key) const {
+        return static_cast<std::size_t>((key * 0x9e3779b97f4a7c15ull) >> shift);
+    }
+
+    void grow() {
+        std::vector<std::uint64_t> old_keys = std::move(keys);
+        std::vector<std::uint32_t> old_values = std::move(values);
+        const std::size_t capacity = old_keys.empty() ? 8 : 2 * old_keys.size();
+        keys.assign(capacity, 0);
+        values.assign(capacity, kNone);
+        mask = capacity - 1;
+        shift = 64 - __builtin_ctzll(capacity);
+        count = 0;
+        for (std::size_t i = 0; i < old_keys.size(); ++i) {
+            if (old_values[i] != kNone) {
+                insert(old_keys[i], old_values[i]);
+            }
+        }
+    }
+};
+
+// Bottom of the van Emde Boas tree: an 8-bit universe as four words, half
+// a cache line, answered with count-trailing-zeros.
+class VebLeaf {
+public:
+    bool empty() const { return (words[0] | words[1] | words[2] | words[3]) == 0; }
+
+    void insert(std::uint64_t x) { words[x >> 6] |= std::uint64_t{ 1 } << (x & 63); }
+
+    std::uint64_t min() const {
+        for (std::uint64_t i = 0; i < 4; ++i) {
+            if (words[i] != 0) {
+                return 64 * i + static_cast<std::uint64_t>(__builtin_ctzll(words[i]));
+            }
+        }
+        throw std::logic_error("VebLeaf is empty");
+    }
+
+    std::uint64_t extract_min() {
+        const std::uint64_t x = min();
+        words[x >> 6] &= words[x >> 6] - 1;
+        return x;
+    }
+
+private:
+    std::uint64_t words[4] = { 0, 0, 0, 0 };
+};
+
+// van Emde Boas node over a Bits-bit universe, for distinct keys, with
+// insert and extract-min only. The minimum is held here and not in a
+// cluster, so either the cluster or the summary recursion is trivial and
+// both operations take O(log log U). Clusters are created on demand, found
+// through a KeyIndexTable and kept in a pool that recycles emptied ones;
+// 64 -> 32 -> 16 -> 8-bit leaves is three levels.
+template <int Bits>
+class VebNode {
+    static constexpr int Half = Bits / 2;
+    using Child = std::conditional_t<Half == 8, VebLeaf, VebNode<Half>>;
+
+public:
+    bool empty() const { return is_empty; }
+    std::uint64_t min() const { return lo; }
+    std::size_t clusters_allocated() const { return pool.size(); }
+
+    void insert(std::uint64_t x) {
+        if (is_empty) {
+            lo = x;
+            is_empty = false;
+            return;
+        }
+        if (x < lo) {
+            std::swap(x, lo);
+        }
+        const std::uint64_t high = x >> Half;
+        const std::uint64_t low = x & ((std::uint64_t{ 1 } << Half) - 1);
+        auto [slot, inserted] = clusters.insert(high, KeyIndexTable::kNone);
+        if (inserted) {
+            *slot = allocate();
+        }
+        Child& cluster = pool[*slot];
+        if (cluster.empty()) {
+            // The cluster insert below is then O(1).
+            summary.insert(high);
+        }
+        cluster.insert(low);
+    }
+
+    std::uint64_t extract_min() {
+        const std::uint64_t result = lo;
+        if (summary.empty()) {
+            is_empty = true;
+            return result;
+        }
+        const std::uint64_t high = summary.min();
+        const std::uint32_t index = *clusters.find(high);
+        Child& cluster = pool[index];
+        lo = (high << Half) | cluster.extract_min();
+        if (cluster.empty()) {
+            summary.extract_min();
+            clusters.erase(high);
+            free_clusters.push_back(index);
+        }
+        return result;
+    }
+
+private:
+    bool is_empty = true;
+    std::uint64_t lo = 0;
+    Child summary;
+    KeyIndexTable clusters;
+    std::vector<Child> pool;
+    std::vector<std::uint32_t> free_clusters;
+
+    std::uint32_t allocate() {
+        if (!free_clusters.empty()) {
+            const std::uint32_t index = free_clusters.back();
+            free_clusters.pop_back();
+            return index;
+        }
+        pool.emplace_back();
+        return static_cast<std::uint32_t>(pool.size() - 1);
+    }
+};
+
+// Integer priority queue over the full 64-bit key universe: a van Emde Boas
+// tree of distinct keys, with the vertices sharing a key chained through a
+// flat node array. Push and pop cost O(log log U) regardless of how widely
+// keys are spread, where the radix heap pays for relocating its buckets.
+class VebQueue {
+public:
+    bool empty() const { return pending == 0; }
+    std::size_t size() const { return pending; }
+    // Distinct keys inserted into the tree.
+    std::uint64_t distinct_keys() const { return key_inserts; }
+
+    void push(std::uint64_t key, int value) {
+        const std::uint32_t node = allocate(value);
+        ++pending;
+        if (current != KeyIndexTable::kNone && key == current_key) {
+            nodes[node].next = current;
+            current = node;
+            return;
+        }
+        auto [slot, inserted] = heads.insert(key, node);
+        if (inserted) {
+            tree.insert(key);
+            ++key_inserts;
+        }
+        else {
+            nodes[node].next = *slot;
+            *slot = node;
+        }
+    }
+
+    std::pair<std::uint64_t, int> pop() {
+        if (current == KeyIndexTable::kNone) {
+            current_key = tree.extract_min();
+            current = heads.erase(current_key);
+        }
+        const std::uint32_t node = current;
+        current = nodes[node].next;
+        free_nodes.push_back(node);
+        --pending;
+        return { current_key, nodes[node].vertex };
+    }
+
+private:
+    struct Node {
+        int vertex;
+        std::uint32_t next;
+    };
+
+    VebNode<64> tree;
+    KeyIndexTable heads;
+    std::vector<Node> nodes;
+    std::vector<std::uint32_t> free_nodes;
+    // Vertices of the key being drained, detached from the tree.
+    std::uint64_t current_key = 0;
+    std::uint32_t current = KeyIndexTable::kNone;
+    std::size_t pending = 0;
+    std::uint64_t key_inserts = 0;
+
+    std::uint32_t allocate(int value) {
+        std::uint32_t index;
+        if (!free_nodes.empty()) {
+            index = free_nodes.back();
+            free_nodes.pop_back();
+            nodes[index] = { value, KeyIndexTable::kNone };
+        }
+        else {
+            index = static_cast<std::uint32_t>(nodes.size());
+            nodes.push_back({ value, KeyIndexTable::kNone });
+        }
+        return index;
+    }
+};
+
+std::vector<std::uint64_t> veb_sssp(const Graph& graph, int source) {
+    return lazy_sssp<VebQueue>(graph, source);
+}
+
+// Pull-based Dijkstra over the radix heap. Each call to next() settles one
+// more vertex and returns it, so a consumer that stops early (nearest-k,
+// first vertex matching a predicate, ...) only pays for what it consumed.
+// The graph must outlive the iterator.
+class SettleOrderIterator {
+public:
+    struct Settled {
+        int vertex;
+        std::uint64_t distance;
+    };
+
+    SettleOrderIterator(const Graph& graph, int source)
+        : graph(&graph),
+          dist(graph.size(), std::numeric_limits<std::uint64_t>::max()),
+          settled_bits(graph.size()) {
+        dist[source] = 0;
+        pq.push(0, source);
+    }
+
+    // Next vertex in non-decreasing distance order, or nullopt once every
+    // reachable vertex has been settled.
+    std::optional<Settled> next() {
+        while (!pq.empty()) {
+            auto [d, u] = pq.pop();
+            if (settled_bits.test(static_cast<std::size_t>(u))) {
+                continue;
+            }
+            settled_bits.set(static_cast<std::size_t>(u));
+            for (const auto& edge : (*graph)[u]) {
+                std::uint64_t nd = d + edge.weight;
+                if (nd < dist[edge.to]) {
+                    dist[edge.to] = nd;
+                    pq.push(nd, edge.to);
+                }
+            }
+            ++settled_count;
+            return Settled{ u, d };
+        }
+        return std::nullopt;
+    }
+
+    std::size_t settled() const { return settled_count; }
+
+    // Final for settled vertices, upper bounds (or INF) for the rest.
+    const std::vector<std::uint64_t>& distances() const { return dist; }
+
+private:
+    const Graph* graph;
+    std::vector<std::uint64_t> dist;
+    SettledBitmap settled_bits;
+    RadixHeap pq;
+    std::size_t settled_count = 0;
+};
+
+// Drains a SettleOrderIterator; used to check it against the batch engines.
+std::vector<std::uint64_t> settle_order_sssp(const Graph& graph, int source) {
+    SettleOrderIterator it(graph, source);
+    while (it.next()) {
+    }
+    return it.distances();
+}
+
+// Orders every adjacency row by ascending weight (ties by target), which lets
+// bounded searches stop scanning a row at the first edge past the bound.
+void sort_adjacency_by_weight(Graph& graph) {
+    sort_rows_by_weight(graph.offsets(), graph.mutable_edges(), graph.size());
+}
+
+// Radix-heap Dijkstra restricted to distances <= bound. When target >= 0 the
+// search stops once the target is settled, and the active bound tightens to
+// the target's tentative distance as soon as it is reached. Vertices outside
+// the bound keep INF (or an upper bound, for point-to-point queries). With
+// rows_sorted the relaxation loop leaves a row at the first edge whose
+// d + w exceeds the bound and counts the rest of the row as pruned.
+std::vector<std::uint64_t> bounded_sssp(const Graph& graph, int source,
+    std::uint64_t bound, int target, bool rows_sorted,
+    SsspCounters* counters = nullptr) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    std::vector<std::uint64_t> dist(graph.size(), INF);
+    dist[source] = 0;
+    SettledBitmap settled(graph.size());
+    SsspCounters local;
+    std::uint64_t limit = bound;
+
+    RadixHeap pq;
+    pq.push(0, source);
+
+    while (!pq.empty()) {
+        auto [d, u] = pq.pop();
+        ++local.pops;
+        if (settled.test(static_cast<std::size_t>(u))) {
+            ++local.stale_pops;
+            continue;
+        }
+        settled.set(static_cast<std::size_t>(u));
+        if (u == target) {
+            break;
+        }
+        const auto& row = graph[u];
+        for (auto it = row.begin(); it != row.end(); ++it) {
+            std::uint64_t nd = d + it->weight;
+            if (nd > limit) {
+                if (rows_sorted) {
+                    local.pruned_edges += static_cast<std::uint64_t>(row.end() - it);
+                    break;
+                }
+                ++local.relaxations;
+                continue;
+            }
+            ++local.relaxations;
+            if (nd < dist[it->to]) {
+                dist[it->to] = nd;
+                pq.push(nd, it->to);
+                ++local.improvements;
+                if (it->to == target) {
+                    limit = nd;
+                }
+            }
+        }
+    }
+
+    if (counters) {
+        *counters = local;
+    }
+    return dist;
+}
+
+// One-to-many query: distances from `source` to each entry of `targets`
+// (duplicates allowed), in the same order, and INF for targets that are
+// unreachable or farther than `bound`. Targets are marked in a bitmap and
+// the search stops as soon as the last one is settled, so a depot with a
+// few hundred nearby stops only explores the region that covers them.
+// Rows sorted by weight are cut off at the bound as in bounded_sssp.
+std::vector<std::uint64_t> one_to_many(const Graph& graph, int source, const std::vector<int>& targets,
+    std::uint64_t bound = std::numeric_limits<std::uint64_t>::max(), bool rows_sorted = false,
+    SsspCounters* counters = nullptr) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    SettledBitmap wanted(graph.size());
+    std::size_t remaining = 0;
+    for (int t : targets) {
+        if (t < 0 || static_cast<std::size_t>(t) >= graph.size()) {
+            throw std::runtime_error("Target " + std::to_string(t) + " is out of range for the graph");
+        }
+        if (!wanted.test(static_cast<std::size_t>(t))) {
+            wanted.set(static_cast<std::size_t>(t));
+            ++remaining;
+        }
+    }
+
+    std::vector<std::uint64_t> dist(graph.size(), INF);
+    dist[source] = 0;
+    SettledBitmap settled(graph.size());
+    SsspCounters local;
+    RadixHeap pq;
+    pq.push(0, source);
+
+    while (remaining > 0 && !pq.empty()) {
+        auto [d, u] = pq.pop();
+        ++local.pops;
+        if (settled.test(static_cast<std::size_t>(u))) {
+            ++local.stale_pops;
+            continue;
+        }
+        settled.set(static_cast<std::size_t>(u));
+        if (wanted.test(static_cast<std::size_t>(u)) && --remaining == 0) {
+            break;
+        }
+        const auto& row = graph[u];
+        for (auto it = row.begin(); it != row.end(); ++it) {
+            std::uint64_t nd = d + it->weight;
+            if (nd > bound) {
+                if (rows_sorted) {
+                    local.pruned_edges += static_cast<std::uint64_t>(row.end() - it);
+                    break;
+                }
+                ++local.relaxations;
+                continue;
+            }
+            ++local.relaxations;
+            if (nd < dist[it->to]) {
+                dist[it->to] = nd;
+                pq.push(nd, it->to);
+                ++local.improvements;
+            }
+        }
+    }
+
+    // Unsettled targets are unreachable within the bound: the search only
+    // ends early once every target is settled.
+    std::vector<std::uint64_t> result;
+    result.reserve(targets.size());
+    for (int t : targets) {
+        result.push_back(settled.test(static_cast<std::size_t>(t)) ? dist[static_cast<std::size_t>(t)] : INF);
+    }
+    if (counters) {
+        *counters = local;
+    }
+    return result;
+}
+
+// Limits for a query that must answer in time. Either limit may be unset.
+struct QueryBudget {
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    // Vertices to settle before giving up (0 = unlimited).
+    std::uint64_t max_settled = 0;
+    // Settles between clock reads; reading the clock every pop costs more
+    // than the pop itself.
+    std::uint64_t check_every = 256;
+};
+
+// Result of a query that may have run out of budget.
+struct PartialSssp {
+    // Final for settled vertices, INF for everything else.
+    std::vector<std::uint64_t> distances;
+    bool complete = true;
+    // Every unsettled vertex is at least this far from the source (INF when
+    // complete): the key of the first vertex the search could not settle.
+    std::uint64_t lower_bound = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t settled = 0;
+    std::uint64_t relaxations = 0;
+};
+
+// bounded_sssp with a time and work budget. The budget is checked right
+// after a live pop and before that vertex is settled, so on expiry the
+// popped key is a lower bound for every vertex still unsettled and the
+// answer is the settled region so far. Completes normally when the target
+// is settled or the bound exhausts the queue first.
+PartialSssp budgeted_sssp(const Graph& graph, int source, const QueryBudget& budget,
+    std::uint64_t bound = std::numeric_limits<std::uint64_t>::max(), int target = -1,
+    bool rows_sorted = false) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    PartialSssp result;
+    std::vector<std::uint64_t> dist(graph.size(), INF);
+    dist[source] = 0;
+    SettledBitmap settled(graph.size());
+    std::uint64_t limit = bound;
+    std::uint64_t until_check = budget.check_every;
+
+    RadixHeap pq;
+    pq.push(0, source);
+    while (!pq.empty()) {
+        auto [d, u] = pq.pop();
+        if (settled.test(static_cast<std::size_t>(u))) {
+            continue;
+        }
+        if (budget.max_settled != 0 && result.settled == budget.max_settled) {
+            result.complete = false;
+        }
+        else if (budget.deadline && --until_check == 0) {
+            until_check = budget.check_every;
+            result.complete = std::chrono::steady_clock::now() < *budget.deadline;
+        }
+        if (!result.complete) {
+            result.lower_bound = d;
+            break;
+        }
+        settled.set(static_cast<std::size_t>(u));
+        ++result.settled;
+        if (u == target) {
+            break;
+        }
+        const auto& row = graph[u];
+        for (auto it = row.begin(); it != row.end(); ++it) {
+            std::uint64_t nd = d + it->weight;
+            if (nd > limit) {
+                if (rows_sorted) {
+                    break;
+                }
+                continue;
+            }
+            ++result.relaxations;
+            if (nd < dist[it->to]) {
+                dist[it->to] = nd;
+                pq.push(nd, it->to);
+                if (it->to == target) {
+                    limit = nd;
+                }
+            }
+        }
+    }
+
+    // Tentative distances of unsettled vertices are only upper bounds.
+    for (std::size_t v = 0; v < dist.size(); ++v) {
+        if (!settled.test(v)) {
+            dist[v] = INF;
+        }
+    }
+    result.distances = std::move(dist);
+    return result;
+}
+
+// How distances between coordinates are measured for A* potentials.
+enum class CoordinateMetric { euclidean, great_circle };
+
+// Admissible, consistent A* potentials from vertex coordinates: the straight
+// line (or great-circle) length to the target times the smallest weight per
+// unit of length over all edges, i.e. the time at the fastest speed any edge
+// allows. Great-circle lengths read x/y as longitude/latitude in millionths
+// of a degree (DIMACS road coordinates) and return metres.
+class GeometricPotential {
+public:
+    GeometricPotential(const Graph& graph, const std::vector<Coordinate>& coords, CoordinateMetric metric)
+        : coords(&coords), metric(metric) {
+        double min_ratio = std::numeric_limits<double>::infinity();
+        for (std::size_t u = 0; u < graph.size(); ++u) {
+            for (const auto& e : graph[static_cast<int>(u)]) {
+                const double len = length(static_cast<int>(u), e.to);
+                if (len > 0.0) {
+                    min_ratio = std::min(min_ratio, static_cast<double>(e.weight) / len);
+                }
+            }
+        }
+        // Shave the scale so rounding in length() cannot break consistency.
+        scale = std::isinf(min_ratio) ? 0.0 : min_ratio * (1.0 - 1e-6);
+        // No potential exceeds scale times the longest possible length. If
+        // that is not a finite, exactly representable integer (coordinates
+        // so far apart that hypot overflows), fall back to the zero
+        // potential rather than cast an out-of-range double.
+        if (!(scale * max_length(graph.size()) < 9007199254740992.0)) {
+            scale = 0.0;
+        }
+    }
+
+    double weight_per_length() const { return scale; }
+
+    double length(int a, int b) const {
+        const Coordinate& p = (*coords)[static_cast<std::size_t>(a)];
+        const Coordinate& q = (*coords)[static_cast<std::size_t>(b)];
+        if (metric == CoordinateMetric::euclidean) {
+            return std::hypot(p.x - q.x, p.y - q.y);
+        }
+        const double to_rad = 3.14159265358979323846 / 180.0 / 1e6;
+        const double lat1 = p.y * to_rad, lat2 = q.y * to_rad;
+        const double s_lat = std::sin((lat2 - lat1) / 2), s_lon = std::sin((q.x - p.x) * to_rad / 2);
+        const double h = s_lat * s_lat + std::cos(lat1) * std::cos(lat2) * s_lon * s_lon;
+        return 2.0 * 6371000.0 * std::asin(std::min(1.0, std::sqrt(h)));
+    }
+
+    // Floored, so pi(u) <= w(u, v) + pi(v) still holds for integer weights
+    // and A* keys stay monotone integers the radix heap accepts.
+    std::uint64_t operator()(int v, int target) const {
+        return static_cast<std::uint64_t>(std::floor(scale * length(v, target)));
+    }
+
+private:
+    // Bounds length() over every pair: the bounding-box diagonal, or half
+    // the earth's circumference.
+    double max_length(std::size_t n) const {
+        if (metric == CoordinateMetric::great_circle) {
+            return 3.14159265358979323846 * 6371000.0;
+        }
+        double lo_x = 0.0, hi_x = 0.0, lo_y = 0.0, hi_y = 0.0;
+        for (std::size_t v = 0; v < n; ++v) {
+            const Coordinate& p = (*coords)[v];
+            lo_x = v ? std::min(lo_x, p.x) : p.x;
+            hi_x = v ? std::max(hi_x, p.x) : p.x;
+            lo_y = v ? std::min(lo_y, p.y) : p.y;
+            hi_y = v ? std::max(hi_y, p.y) : p.y;
+        }
+        return std::hypot(hi_x - lo_x, hi_y - lo_y);
+    }
+
+    const std::vector<Coordinate>* coords;
+    CoordinateMetric metric;
+    double scale = 0.0;
+};
+
+// Point-to-point A* over the radix heap: keys are dist + pi(v). Only the
+// target's entry of the returned vector is final; the rest are upper bounds
+// (INF where unexplored).
+std::vector<std::uint64_t> astar_sssp(const Graph& graph, int source, int target,
+    const GeometricPotential& potential, SsspCounters* counters = nullptr) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    std::vector<std::uint64_t> dist(graph.size(), INF);
+    // Potentials are computed on first touch.
+    std::vector<std::uint64_t> pi(graph.size(), INF);
+    auto pot = [&](int v) {
+        std::uint64_t& p = pi[static_cast<std::size_t>(v)];
+        if (p == INF) {
+            p = potential(v, target);
+        }
+        return p;
+    };
+    dist[source] = 0;
+    SettledBitmap settled(graph.size());
+    SsspCounters local;
+
+    RadixHeap pq;
+    pq.push(pot(source), source);
+
+    while (!pq.empty()) {
+        auto [key, u] = pq.pop();
+        ++local.pops;
+        if (settled.test(static_cast<std::size_t>(u))) {
+            ++local.stale_pops;
+            continue;
+        }
+        settled.set(static_cast<std::size_t>(u));
+        if (u == target) {
+            break;
+        }
+        const std::uint64_t d = dist[u];
+        for (const auto& e : graph[u]) {
+            ++local.relaxations;
+            std::uint64_t nd = d + e.weight;
+            if (nd < dist[e.to]) {
+                dist[e.to] = nd;
+                pq.push(nd + pot(e.to), e.to);
+                ++local.improvements;
+            }
+        }
+    }
+
+    if (counters) {
+        *counters = local;
+    }
+    return dist;
+}
+
+// Allocator returning cache-line aligned storage.
+template <typename T>
+struct CacheAlignedAllocator {
+    using value_type = T;
+
+    CacheAlignedAllocator() = default;
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(
+            ::operator new(n * sizeof(T), std::align_val_t(kCacheLineBytes)));
+    }
+    void deallocate(T* p, std::size_t) {
+        ::operator delete(p, std::align_val_t(kCacheLineBytes));
+    }
+
+    template <typename U>
+    bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+
+// Implicit 8-ary min-heap whose sibling groups fill exactly one cache line.
+// Keys live in their own aligned array, offset so that the children of node i
+// (indices 8i+1 .. 8i+8) start on a line boundary; vertex ids sit in a
+// parallel array that is only touched when an entry actually moves. Unused
+// key slots hold UINT64_MAX, so a full group can always be scanned at once.
+class AlignedDaryHeap {
+public:
+    static constexpr std::size_t kArity = kCacheLineBytes / sizeof(std::uint64_t);
+
+    AlignedDaryHeap() : keys(kPad + 4 * kArity, kEmptyKey), values(4 * kArity), sz(0) {}
+
+    bool empty() const { return sz == 0; }
+    std::size_t size() const { return sz; }
+
+    void push(std::uint64_t key, int value) {
+        if (kPad + sz + kArity >= keys.size()) {
+            keys.resize(2 * keys.size(), kEmptyKey);
+            values.resize(keys.size() - kPad);
+        }
+        // Hole-based sift-up: shift parents down and write the new entry once.
+        std::size_t i = sz++;
+        while (i > 0) {
+            std::size_t parent = (i - 1) / kArity;
+            if (key >= key_at(parent)) {
+                break;
+            }
+            key_at(i) = key_at(parent);
+            values[i] = values[parent];
+            i = parent;
+        }
+        key_at(i) = key;
+        values[i] = value;
+    }
+
+    std::pair<std::uint64_t, int> pop() {
+        std::pair<std::uint64_t, int> res{ key_at(0), values[0] };
+        std::size_t last = --sz;
+        std::uint64_t key = key_at(last);
+        int value = values[last];
+        key_at(last) = kEmptyKey;
+        if (sz == 0) {
+            return res;
+        }
+
+        // Hole-based sift-down from the root.
+        std::size_t i = 0;
+        for (;;) {
+            std::size_t first = kArity * i + 1;
+            if (first >= sz) {
+                break;
+            }
+            std::size_t child = first + min_child(&key_at(first));
+            if (key_at(child) >= key) {
+                break;
+            }
+            key_at(i) = key_at(child);
+            values[i] = values[child];
+            i = child;
+        }
+        key_at(i) = key;
+        values[i] = value;
+        return res;
+    }
+
+private:
+    static constexpr std::uint64_t kEmptyKey = std::numeric_limits<std::uint64_t>::max();
+    // Padding that moves index 1 onto a cache-line boundary.
+    static constexpr std::size_t kPad = kArity - 1;
+
+    std::vector<std::uint64_t, CacheAlignedAllocator<std::uint64_t>> keys;
+    std::vector<int> values;
+    std::size_t sz;
+
+    std::uint64_t& key_at(std::size_t i) { return keys[i + kPad]; }
+
+    // Index (0..7) of the smallest key in an aligned group of eight.
+    static std::size_t min_child(const std::uint64_t* group) {
+#if defined(__AVX2__)
+        // AVX2 only compares signed 64-bit lanes, so flip the sign bit first.
+        const __m256i bias = _mm256_set1_epi64x(std::numeric_limits<std::int64_t>::min());
+        __m256i lo = _mm256_xor_si256(
+            _mm256_load_si256(reinterpret_cast<const __m256i*>(group)), bias);
+        __m256i hi = _mm256_xor_si256(
+            _mm256_load_si256(reinterpret_cast<const __m256i*>(group + 4)), bias);
+        __m256i gt = _mm256_cmpgt_epi64(lo, hi);
+        __m256i key = _mm256_blendv_epi8(lo, hi, gt);
+        __m256i idx = _mm256_blendv_epi8(_mm256_set_epi64x(3, 2, 1, 0),
+            _mm256_set_epi64x(7, 6, 5, 4), gt);
+
+        // Fold the upper 128-bit half onto the lower one.
+        __m256i key2 = _mm256_permute4x64_epi64(key, 0x4E);
+        __m256i idx2 = _mm256_permute4x64_epi64(idx, 0x4E);
+        gt = _mm256_cmpgt_epi64(key, key2);
+        key = _mm256_blendv_epi8(key, key2, gt);
+        idx = _mm256_blendv_epi8(idx, idx2, gt);
+
+        // Fold the remaining pair of 64-bit lanes.
+        key2 = _mm256_shuffle_epi32(key, 0x4E);
+        idx2 = _mm256_shuffle_epi32(idx, 0x4E);
+        gt = _mm256_cmpgt_epi64(key, key2);
+        idx = _mm256_blendv_epi8(idx, idx2, gt);
+        return static_cast<std::size_t>(_mm256_cvtsi256_si32(idx));
+#else
+        std::size_t best = 0;
+        for (std::size_t c = 1; c < kArity; ++c) {
+            if (group[c] < group[best]) {
+                best = c;
+            }
+        }
+        return best;
+#endif
+    }
+};
+
+std::vector<std::uint64_t> dijkstra_aligned_heap(const Graph& graph, int source) {
+    return lazy_sssp<AlignedDaryHeap>(graph, source);
+}
+
+#if defined(__linux__)
+// Counts last-level cache misses of the calling thread via perf_event_open.
+class CacheMissCounter {
+public:
+    CacheMissCounter() {
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~CacheMissCounter() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    CacheMissCounter(const CacheMissCounter&) = delete;
+    CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+    bool available() const { return fd >= 0; }
+
+    void start() {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    std::uint64_t stop() {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        std::uint64_t count = 0;
+        if (read(fd, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count))) {
+            return 0;
+        }
+        return count;
+    }
+
+private:
+    int fd = -1;
+};
+#else
+class CacheMissCounter {
+public:
+    bool available() const { return false; }
+    void start() {}
+    std::uint64_t stop() { return 0; }
+};
+#endif
+
+// Runs one lazy_sssp pass per heap under a hardware cache-miss counter and
+// prints misses per pop, so heap layouts can be compared on the same input.
+void report_heap_cache_misses(const Graph& graph, int source) {
+    CacheMissCounter counter;
+    if (!counter.available()) {
+        std::cout << "Cache misses per pop: n/a (hardware perf counters unavailable)"
+            << std::endl;
+        return;
+    }
+
+    auto measure = [&](const std::string& name, auto run) {
+        SsspCounters stats;
+        counter.start();
+        run(stats);
+        std::uint64_t misses = counter.stop();
+        double per_pop = stats.pops == 0 ? 0.0
+            : static_cast<double>(misses) / static_cast<double>(stats.pops);
+        std::cout << std::setw(30) << std::left << name << ": " << std::fixed
+            << std::setprecision(3) << per_pop << " cache misses/pop (" << misses
+            << " misses, " << stats.pops << " pops)" << std::endl;
+    };
+
+    measure("Binary heap", [&](SsspCounters& stats) {
+        lazy_sssp<BinaryHeap>(graph, source, &stats);
+    });
+    measure("8-ary aligned heap", [&](SsspCounters& stats) {
+        lazy_sssp<AlignedDaryHeap>(graph, source, &stats);
+    });
+}
+
+// Heap occupancy of lazy insertion against in-place decrease-key on the
+// radix heap: total entries pushed, pops wasted on stale entries, and the
+// largest heap size.
+void report_heap_entries(const Graph& graph, int source) {
+    SsspCounters lazy;
+    lazy_sssp<RadixHeap>(graph, source, &lazy);
+    SsspCounters indexed;
+    std::size_t peak = 0;
+    radix_decrease_key_sssp(graph, source, &indexed, &peak);
+
+    std::cout << std::setw(30) << std::left << "Radix heap entries (lazy)" << ": "
+        << lazy.improvements + 1 << " pushed, " << lazy.stale_pops << " stale pops" << std::endl;
+    std::cout << std::setw(30) << std::left << "Radix heap entries (indexed)" << ": "
+        << indexed.pops << " pushed, " << indexed.improvements + 1 - indexed.pops
+        << " decrease-keys, peak " << peak << " of " << graph.size() << " vertices" << std::endl;
+}
+
+// Where the two integer queues spend their work: buckets the radix heap had
+// to redistribute (and entries moved) against distinct keys in the vEB tree.
+// Wide-range weights push the first up while the second stays at one
+// insert per distinct distance.
+void report_integer_queues(const Graph& graph, int source) {
+    SsspCounters stats;
+    RadixHeap radix;
+    lazy_sssp(graph, source, radix, &stats);
+    const double per_pop = stats.pops == 0 ? 0.0
+        : static_cast<double>(radix.relocated_entries()) / static_cast<double>(stats.pops);
+    std::cout << std::setw(30) << std::left << "Radix heap relocations" << ": "
+        << radix.relocations() << " buckets, " << radix.relocated_entries() << " entries moved ("
+        << std::fixed << std::setprecision(2) << per_pop << " per pop)" << std::endl;
+
+    VebQueue veb;
+    lazy_sssp(graph, source, veb, &stats);
+    std::cout << std::setw(30) << std::left << "vEB queue keys" << ": " << veb.distinct_keys()
+        << " distinct keys for " << stats.pops << " pops" << std::endl;
+}
+
+// Single-thread memory roofs measured on this machine.
+struct MemoryProbe {
+    // STREAM triad a[i] = b[i] + s * c[i], counting 24 bytes per element.
+    double triad_gbps = 0.0;
+    // Dependent loads over a random cycle of cache lines much larger than
+    // the last-level cache.
+    double latency_ns = 0.0;
+};
+
+// Makes a value observable to the compiler, so the benchmark loop producing
+// it cannot be removed. With GCC/Clang the memory clobber also keeps every
+// store before it (the whole triad array).
+template <typename T>
+void benchmark_sink(const T& value) {
+#if defined(__GNUC__)
+    asm volatile("" : : "r"(&value) : "memory");
+#else
+    static volatile T sink;
+    sink = value;
+#endif
+}
+
+MemoryProbe probe_memory() {
+    MemoryProbe probe;
+    const std::size_t n = std::size_t{ 4 } << 20;
+    std::vector<double> a(n, 0.0), b(n, 1.0), c(n, 2.0);
+    const double scalar = 3.0;
+    double best_ms = std::numeric_limits<double>::infinity();
+    for (int rep = 0; rep < 5; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < n; ++i) {
+            a[i] = b[i] + scalar * c[i];
+        }
+        benchmark_sink(a[0]);
+        best_ms = std::min(best_ms, elapsed_ms(start));
+    }
+    probe.triad_gbps = 3.0 * sizeof(double) * static_cast<double>(n) / (best_ms * 1e6);
+
+    // Sattolo's shuffle yields a single cycle through every line.
+    struct alignas(kCacheLineBytes) Line {
+        std::size_t next;
+    };
+    const std::size_t lines = (std::size_t{ 64 } << 20) / sizeof(Line);
+    std::vector<Line> chain(lines);
+    std::vector<std::size_t> order(lines);
+    std::iota(order.begin(), order.end(), std::size_t{ 0 });
+    std::uint64_t state = 0x9e3779b97f4a7c15ull;
+    for (std::size_t i = lines - 1; i > 0; --i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        std::swap(order[i], order[state % i]);
+    }
+    for (std::size_t i = 0; i < lines; ++i) {
+        chain[order[i]].next = order[(i + 1) % lines];
+    }
+    const std::size_t steps = std::size_t{ 2 } << 20;
+    std::size_t at = order[0];
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < steps; ++i) {
+        at = chain[at].next;
+    }
+    benchmark_sink(at);
+    const double chase_ms = elapsed_ms(start);
+    probe.latency_ns = chase_ms * 1e6 / static_cast<double>(steps);
+    return probe;
+}
+
+// Places the two main engines against the measured roofs. Bytes come from
+// the CSR layout and the operation counters: every relaxation streams one
+// Edge and reads dist[to], improvements write dist and push a heap entry,
+// every pop reads two offsets and moves its entry, and binary-heap pushes
+// and pops sift through about log2(n) levels. Relaxations and pops are also
+// the random accesses (dist[to], the row start) that can each miss to DRAM.
+void report_roofline(const Graph& graph, int source) {
+    const MemoryProbe probe = probe_memory();
+    std::cout << "Roofline: triad " << std::fixed << std::setprecision(2) << probe.triad_gbps
+        << " GB/s, pointer-chase latency " << std::setprecision(1) << probe.latency_ns
+        << " ns (single thread)" << std::endl;
+
+    auto measure = [&](const std::string& name, auto run, double heap_levels) {
+        SsspCounters stats;
+        CacheMissCounter counter;
+        if (counter.available()) {
+            counter.start();
+        }
+        auto start = std::chrono::steady_clock::now();
+        run(stats);
+        const double ms = elapsed_ms(start);
+        const std::uint64_t misses = counter.available() ? counter.stop() : 0;
+
+        const std::uint64_t heap_entry = sizeof(std::pair<std::uint64_t, int>);
+        const double bytes = static_cast<double>(stats.relaxations) * (sizeof(Edge) + sizeof(std::uint64_t))
+            + static_cast<double>(stats.improvements) * sizeof(std::uint64_t)
+            + static_cast<double>(stats.pops) * 2 * sizeof(std::uint64_t)
+            + static_cast<double>(stats.pops) * 2 * heap_entry * heap_levels;
+        const double gbps = bytes / (ms * 1e6);
+        const std::uint64_t random_accesses = stats.relaxations + stats.pops;
+        // With counters, charge only the accesses that actually missed.
+        const std::uint64_t charged = counter.available() ? std::min(misses, random_accesses) : random_accesses;
+        const double ns_per_access = charged == 0 ? 0.0 : ms * 1e6 / static_cast<double>(charged);
+
+        std::string verdict;
+        if (gbps >= 0.6 * probe.triad_gbps) {
+            verdict = "bandwidth-bound";
+        }
+        else if (ns_per_access <= 1.5 * probe.latency_ns) {
+            verdict = "latency-bound";
+        }
+        else {
+            verdict = "compute/heap-bound";
+        }
+        std::cout << std::setw(30) << std::left << name << ": " << std::fixed << std::setprecision(1)
+            << bytes / (1024.0 * 1024.0) << " MiB est. in " << std::setprecision(3) << ms << " ms = "
+            << std::setprecision(2) << gbps << " GB/s (" << std::setprecision(1)
+            << 100.0 * gbps / probe.triad_gbps << "% of triad), " << ns_per_access << " ns per "
+            << (counter.available() ? "miss" : "random access") << " vs " << probe.latency_ns
+            << " ns latency -> " << verdict << std::endl;
+    };
+
+    const double levels = std::max(1.0, std::log2(static_cast<double>(std::max<std::size_t>(2, graph.size()))));
+    measure("Dijkstra (binary heap)", [&](SsspCounters& stats) {
+        lazy_sssp<BinaryHeap>(graph, source, &stats);
+    }, levels);
+    measure("Breaking Sorting Barrier SSSP", [&](SsspCounters& stats) {
+        lazy_sssp<RadixHeap>(graph, source, &stats);
+    }, 1.0);
+}
+
+// A relaxation request addressed to the rank that owns `vertex`.
+struct RemoteRelaxation {
+    std::uint64_t distance;
+    int vertex;
+};
+
+// Work and traffic of one rank in a distributed run.
+struct RankStats {
+    std::uint64_t owned_vertices = 0;
+    std::uint64_t edge_relaxations = 0;
+    // Non-empty batches sent to other ranks (one per destination per round).
+    std::uint64_t messages_sent = 0;
+    std::uint64_t relaxations_sent = 0;
+    std::uint64_t bytes_sent = 0;
+    // Collective steps: exchange rounds plus reductions.
+    std::uint64_t sync_rounds = 0;
+    double elapsed_ms = 0.0;
+};
+
+// Collectives used by distributed delta-stepping. Every rank must call them
+// in the same order; implementations account traffic in stats().
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    virtual int rank() const = 0;
+    virtual int ranks() const = 0;
+
+    // Delivers outgoing[r] to rank r (outgoing[rank()] is ignored), replaces
+    // `incoming` with everything addressed to this rank and clears `outgoing`.
+    virtual void exchange(std::vector<std::vector<RemoteRelaxation>>& outgoing,
+        std::vector<RemoteRelaxation>& incoming) = 0;
+    virtual std::uint64_t all_reduce_min(std::uint64_t value) = 0;
+
+    RankStats& stats() { return counters; }
+
+protected:
+    RankStats counters;
+};
+
+// 1D block partitioning: rank r owns vertices [r * chunk, (r + 1) * chunk).
+std::size_t partition_chunk(std::size_t node_count, int ranks) {
+    return std::max<std::size_t>(1, (node_count + static_cast<std::size_t>(ranks) - 1)
+        / static_cast<std::size_t>(ranks));
+}
+
+// Bucket width heuristic from Meyer & Sanders: max weight over average degree.
+std::uint64_t default_delta(const Graph& graph) {
+    std::uint64_t max_weight = 0;
+    const std::size_t edges = graph.edge_count();
+    for (std::size_t i = 0; i < edges; ++i) {
+        max_weight = std::max(max_weight, graph.edges()[i].weight);
+    }
+    if (edges == 0) {
+        return 1;
+    }
+    double avg_degree = static_cast<double>(edges) / static_cast<double>(graph.size());
+    return std::max<std::uint64_t>(1,
+        static_cast<std::uint64_t>(static_cast<double>(max_weight) / std::max(1.0, avg_degree)));
+}
+
+// Keeps one request per target vertex (the smallest distance) in a batch.
+void aggregate_relaxations(std::vector<RemoteRelaxation>& batch) {
+    std::sort(batch.begin(), batch.end(), [](const RemoteRelaxation& a, const RemoteRelaxation& b) {
+        return std::tie(a.vertex, a.distance) < std::tie(b.vertex, b.distance);
+    });
+    batch.erase(std::unique(batch.begin(), batch.end(),
+        [](const RemoteRelaxation& a, const RemoteRelaxation& b) { return a.vertex == b.vertex; }),
+        batch.end());
+}
+
+// One rank of bulk-synchronous delta-stepping. The rank keeps distances and
+// a bucket queue for the vertices it owns and scans only their rows;
+// relaxations of remote vertices are aggregated per destination and shipped
+// once per phase. Returns the final distances of the owned block.
+std::vector<std::uint64_t> delta_stepping_rank(const Graph& graph, int source,
+    std::uint64_t delta, Transport& transport) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    const int ranks = transport.ranks();
+    const int me = transport.rank();
+    const std::size_t chunk = partition_chunk(graph.size(), ranks);
+    const std::size_t first = std::min(graph.size(), chunk * static_cast<std::size_t>(me));
+    const std::size_t last = std::min(graph.size(), first + chunk);
+    RankStats& stats = transport.stats();
+    stats.owned_vertices = last - first;
+
+    std::vector<std::uint64_t> dist(last - first, INF);
+    // Last phase in which a vertex was expanded, and last bucket it was
+    // recorded in for the heavy-edge pass.
+    std::vector<std::uint64_t> expanded_in(last - first, INF);
+    std::vector<std::uint64_t> removed_from(last - first, INF);
+    std::map<std::uint64_t, std::vector<int>> buckets;
+    std::vector<std::vector<RemoteRelaxation>> outgoing(static_cast<std::size_t>(ranks));
+    std::vector<RemoteRelaxation> incoming;
+
+    auto relax_owned = [&](int v, std::uint64_t nd) {
+        auto& slot = dist[static_cast<std::size_t>(v) - first];
+        if (nd < slot) {
+            slot = nd;
+            buckets[nd / delta].push_back(v);
+        }
+    };
+    auto relax = [&](int v, std::uint64_t nd) {
+        std::size_t owner = static_cast<std::size_t>(v) / chunk;
+        if (owner == static_cast<std::size_t>(me)) {
+            relax_owned(v, nd);
+        }
+        else {
+            outgoing[owner].push_back({ nd, v });
+        }
+    };
+    auto flush = [&]() {
+        for (auto& batch : outgoing) {
+            aggregate_relaxations(batch);
+        }
+        transport.exchange(outgoing, incoming);
+        for (const auto& request : incoming) {
+            relax_owned(request.vertex, request.distance);
+        }
+    };
+
+    if (static_cast<std::size_t>(source) >= first && static_cast<std::size_t>(source) < last) {
+        relax_owned(source, 0);
+    }
+
+    std::uint64_t phase = 0;
+    for (;;) {
+        std::uint64_t local_min = buckets.empty() ? INF : buckets.begin()->first;
+        const std::uint64_t b = transport.all_reduce_min(local_min);
+        if (b == INF) {
+            break;
+        }
+
+        // Light edges may refill bucket b, so repeat until it is empty on
+        // every rank.
+        std::vector<int> removed;
+        for (;;) {
+            ++phase;
+            std::vector<int> frontier;
+            auto it = buckets.find(b);
+            if (it != buckets.end()) {
+                frontier.swap(it->second);
+                buckets.erase(it);
+            }
+            for (int v : frontier) {
+                std::size_t i = static_cast<std::size_t>(v) - first;
+                std::uint64_t d = dist[i];
+                if (d / delta != b || expanded_in[i] == phase) {
+                    continue;
+                }
+                expanded_in[i] = phase;
+                if (removed_from[i] != b) {
+                    removed_from[i] = b;
+                    removed.push_back(v);
+                }
+                for (const auto& edge : graph[static_cast<std::size_t>(v)]) {
+                    if (edge.weight <= delta) {
+                        ++stats.edge_relaxations;
+                        relax(edge.to, d + edge.weight);
+                    }
+                }
+            }
+            flush();
+            bool refilled = buckets.count(b) != 0;
+            if (transport.all_reduce_min(refilled ? 0 : 1) != 0) {
+                break;
+            }
+        }
+
+        // Distances in bucket b are final now; relax heavy edges once.
+        for (int v : removed) {
+            std::uint64_t d = dist[static_cast<std::size_t>(v) - first];
+            for (const auto& edge : graph[static_cast<std::size_t>(v)]) {
+                if (edge.weight > delta) {
+                    ++stats.edge_relaxations;
+                    relax(edge.to, d + edge.weight);
+                }
+            }
+        }
+        flush();
+    }
+
+    return dist;
+}
+
+#if defined(__unix__)
+// Anonymous MAP_SHARED mapping; created before fork() so every rank sees it.
+class SharedMapping {
+public:
+    explicit SharedMapping(std::size_t bytes) : bytes(std::max<std::size_t>(bytes, 1)) {
+        ptr = mmap(nullptr, this->bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error("Failed to map shared memory");
+        }
+    }
+    ~SharedMapping() { munmap(ptr, bytes); }
+    SharedMapping(const SharedMapping&) = delete;
+    SharedMapping& operator=(const SharedMapping&) = delete;
+
+    void* data() const { return ptr; }
+
+private:
+    void* ptr;
+    std::size_t bytes;
+};
+
+// Transport over a shared segment on one host: a process-shared barrier, one
+// reduction slot per rank and a fixed-capacity mailbox per (sender, receiver)
+// pair. Batches larger than a mailbox are drained over several rounds.
+class ShmTransport : public Transport {
+public:
+    static std::size_t segment_bytes(int ranks, std::size_t capacity) {
+        auto p = static_cast<std::size_t>(ranks);
+        return layout(p).boxes + p * p * capacity * sizeof(RemoteRelaxation);
+    }
+
+    // Prepares a zeroed segment; call once before forking the ranks.
+    static void initialize(void* segment, int ranks, std::size_t capacity) {
+        auto* header = static_cast<Header*>(segment);
+        pthread_barrierattr_t attr;
+        pthread_barrierattr_init(&attr);
+        pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        if (pthread_barrier_init(&header->barrier, &attr, static_cast<unsigned>(ranks)) != 0) {
+            throw std::runtime_error("Failed to create process-shared barrier");
+        }
+        pthread_barrierattr_destroy(&attr);
+        header->ranks = ranks;
+        header->capacity = capacity;
+    }
+
+    static void destroy(void* segment) {
+        pthread_barrier_destroy(&static_cast<Header*>(segment)->barrier);
+    }
+
+    ShmTransport(void* segment, int rank) : header(static_cast<Header*>(segment)), me(rank) {
+        auto* base = static_cast<char*>(segment);
+        Layout l = layout(static_cast<std::size_t>(header->ranks));
+        slots = reinterpret_cast<std::uint64_t*>(base + l.slots);
+        counts = reinterpret_cast<std::uint64_t*>(base + l.counts);
+        boxes = reinterpret_cast<RemoteRelaxation*>(base + l.boxes);
+    }
+
+    int rank() const override { return me; }
+    int ranks() const override { return header->ranks; }
+
+    void exchange(std::vector<std::vector<RemoteRelaxation>>& outgoing,
+        std::vector<RemoteRelaxation>& incoming) override {
+        const int p = header->ranks;
+        const std::size_t capacity = header->capacity;
+        std::vector<std::size_t> sent(static_cast<std::size_t>(p), 0);
+        incoming.clear();
+
+        for (;;) {
+            bool pending = false;
+            for (int to = 0; to < p; ++to) {
+                std::size_t n = 0;
+                if (to != me) {
+                    const auto& batch = outgoing[static_cast<std::size_t>(to)];
+                    std::size_t& done = sent[static_cast<std::size_t>(to)];
+                    n = std::min(capacity, batch.size() - done);
+                    std::copy_n(batch.data() + done, n, mailbox(me, to));
+                    done += n;
+                    pending = pending || done < batch.size();
+                    if (n > 0) {
+                        ++counters.messages_sent;
+                        counters.relaxations_sent += n;
+                        counters.bytes_sent += n * sizeof(RemoteRelaxation);
+                    }
+                }
+                counts[index(me, to)] = n;
+            }
+            slots[me] = pending ? 1 : 0;
+            barrier();
+
+            bool any_pending = false;
+            for (int from = 0; from < p; ++from) {
+                any_pending = any_pending || slots[from] != 0;
+                if (from != me) {
+                    const RemoteRelaxation* box = mailbox(from, me);
+                    incoming.insert(incoming.end(), box, box + counts[index(from, me)]);
+                }
+            }
+            // Nobody refills a mailbox before every rank has drained it.
+            barrier();
+            ++counters.sync_rounds;
+            if (!any_pending) {
+                break;
+            }
+        }
+
+        for (auto& batch : outgoing) {
+            batch.clear();
+        }
+    }
+
+    std::uint64_t all_reduce_min(std::uint64_t value) override {
+        slots[me] = value;
+        barrier();
+        std::uint64_t result = *std::min_element(slots, slots + header->ranks);
+        barrier();
+        ++counters.sync_rounds;
+        return result;
+    }
+
+private:
+    struct Header {
+        pthread_barrier_t barrier;
+        int ranks;
+        std::size_t capacity;
+    };
+    struct Layout {
+        std::size_t slots;
+        std::size_t counts;
+        std::size_t boxes;
+    };
+
+    Header* header;
+    std::uint64_t* slots = nullptr;
+    std::uint64_t* counts = nullptr;
+    RemoteRelaxation* boxes = nullptr;
+    int me;
+
+    static std::size_t align_line(std::size_t offset) {
+        return (offset + kCacheLineBytes - 1) / kCacheLineBytes * kCacheLineBytes;
+    }
+
+    static Layout layout(std::size_t ranks) {
+        Layout l{};
+        l.slots = align_line(sizeof(Header));
+        l.counts = align_line(l.slots + ranks * sizeof(std::uint64_t));
+        l.boxes = align_line(l.counts + ranks * ranks * sizeof(std::uint64_t));
+        return l;
+    }
+
+    std::size_t index(int from, int to) const {
+        return static_cast<std::size_t>(from) * static_cast<std::size_t>(header->ranks)
+            + static_cast<std::size_t>(to);
+    }
+
+    RemoteRelaxation* mailbox(int from, int to) { return boxes + index(from, to) * header->capacity; }
+
+    void barrier() { pthread_barrier_wait(&header->barrier); }
+};
+
+// Forks `ranks` processes that each run delta_stepping_rank over their block
+// of vertices and exchange relaxations through a ShmTransport. Final
+// distances and per-rank statistics come back through shared memory.
+std::vector<std::uint64_t> distributed_delta_stepping(const Graph& graph, int source,
+    int ranks, std::uint64_t delta, std::vector<RankStats>* rank_stats = nullptr) {
+    const std::size_t n = graph.size();
+    const std::size_t chunk = partition_chunk(n, ranks);
+    // Bound the mailboxes to ~64 MiB in total; bigger batches take more rounds.
+    const std::size_t budget = (std::size_t{ 64 } << 20) / sizeof(RemoteRelaxation);
+    const std::size_t capacity = std::max<std::size_t>(1024,
+        budget / (static_cast<std::size_t>(ranks) * static_cast<std::size_t>(ranks)));
+
+    SharedMapping segment(ShmTransport::segment_bytes(ranks, capacity));
+    ShmTransport::initialize(segment.data(), ranks, capacity);
+    SharedMapping results(n * sizeof(std::uint64_t) + static_cast<std::size_t>(ranks) * sizeof(RankStats));
+    auto* dist_out = static_cast<std::uint64_t*>(results.data());
+    auto* stats_out = reinterpret_cast<RankStats*>(dist_out + n);
+
+    std::vector<pid_t> children;
+    for (int r = 0; r < ranks; ++r) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            for (pid_t child : children) {
+                kill(child, SIGKILL);
+                waitpid(child, nullptr, 0);
+            }
+            ShmTransport::destroy(segment.data());
+            throw std::runtime_error("fork() failed while starting distributed ranks");
+        }
+        if (pid == 0) {
+            int code = 0;
+            try {
+                ShmTransport transport(segment.data(), r);
+                auto start = std::chrono::steady_clock::now();
+                auto local = delta_stepping_rank(graph, source, delta, transport);
+                std::chrono::duration<double, std::milli> elapsed =
+                    std::chrono::steady_clock::now() - start;
+                // Ranks past the last block own nothing; clamp so the
+                // pointer stays within the array.
+                std::copy(local.begin(), local.end(), dist_out + std::min(n, chunk * static_cast<std::size_t>(r)));
+                transport.stats().elapsed_ms = elapsed.count();
+                stats_out[r] = transport.stats();
+            }
+            catch (const std::exception& ex) {
+                std::cerr << "Rank " << r << " failed: " << ex.what() << std::endl;
+                code = 1;
+            }
+            _exit(code);
+        }
+        children.push_back(pid);
+    }
+
+    // A failed rank would leave its peers blocked on the barrier.
+    bool failed = false;
+    for (std::size_t remaining = children.size(); remaining > 0; --remaining) {
+        int status = 0;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            break;
+        }
+        children.erase(std::remove(children.begin(), children.end(), pid), children.end());
+        if (!failed && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+            failed = true;
+            for (pid_t child : children) {
+                kill(child, SIGKILL);
+            }
+        }
+    }
+    ShmTransport::destroy(segment.data());
+    if (failed) {
+        throw std::runtime_error("A distributed rank exited abnormally");
+    }
+
+    if (rank_stats) {
+        rank_stats->assign(stats_out, stats_out + ranks);
+    }
+    return std::vector<std::uint64_t>(dist_out, dist_out + n);
+}
+#else
+std::vector<std::uint64_t> distributed_delta_stepping(const Graph&, int, int, std::uint64_t,
+    std::vector<RankStats>* = nullptr) {
+    throw std::runtime_error("Distributed mode needs POSIX fork() and shared memory");
+}
+#endif
+
+void print_rank_stats(const std::vector<RankStats>& stats) {
+    RankStats total;
+    double slowest_ms = 0.0;
+    for (std::size_t r = 0; r < stats.size(); ++r) {
+        const RankStats& s = stats[r];
+        std::cout << "  rank " << r << ": " << s.owned_vertices << " vertices, "
+            << s.edge_relaxations << " relaxations, sent " << s.relaxations_sent
+            << " requests in " << s.messages_sent << " messages (" << s.bytes_sent
+            << " bytes), " << s.sync_rounds << " sync rounds, " << std::fixed
+            << std::setprecision(3) << s.elapsed_ms << " ms" << std::endl;
+        total.edge_relaxations += s.edge_relaxations;
+        total.messages_sent += s.messages_sent;
+        total.relaxations_sent += s.relaxations_sent;
+        total.bytes_sent += s.bytes_sent;
+        total.sync_rounds = std::max(total.sync_rounds, s.sync_rounds);
+        slowest_ms = std::max(slowest_ms, s.elapsed_ms);
+    }
+    std::cout << "  total: " << total.edge_relaxations << " relaxations, "
+        << total.relaxations_sent << " remote requests in " << total.messages_sent
+        << " messages (" << total.bytes_sent << " bytes), " << total.sync_rounds
+        << " sync rounds, slowest rank " << std::fixed << std::setprecision(3)
+        << slowest_ms << " ms" << std::endl;
+}
+
+// In-process Transport: ranks are threads sharing one ThreadExchange, with
+// unbounded per-pair mailboxes and a condition-variable barrier.
+class ThreadExchange {
+public:
+    explicit ThreadExchange(int ranks)
+        : ranks(ranks), slots(static_cast<std::size_t>(ranks)),
+          boxes(static_cast<std::size_t>(ranks) * static_cast<std::size_t>(ranks)) {}
+
+    void barrier() {
+        std::unique_lock<std::mutex> lock(mutex);
+        const std::uint64_t generation = generations;
+        if (++arrived == ranks) {
+            arrived = 0;
+            ++generations;
+            released.notify_all();
+            return;
+        }
+        released.wait(lock, [&] { return generations != generation; });
+    }
+
+    const int ranks;
+    std::vector<std::uint64_t> slots;
+    // boxes[from * ranks + to]
+    std::vector<std::vector<RemoteRelaxation>> boxes;
+
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    int arrived = 0;
+    std::uint64_t generations = 0;
+};
+
+class ThreadTransport : public Transport {
+public:
+    ThreadTransport(ThreadExchange& shared, int rank) : shared(shared), me(rank) {}
+
+    int rank() const override { return me; }
+    int ranks() const override { return shared.ranks; }
+
+    void exchange(std::vector<std::vector<RemoteRelaxation>>& outgoing,
+        std::vector<RemoteRelaxation>& incoming) override {
+        const int p = shared.ranks;
+        for (int to = 0; to < p; ++to) {
+            auto& batch = outgoing[static_cast<std::size_t>(to)];
+            if (to != me && !batch.empty()) {
+                ++counters.messages_sent;
+                counters.relaxations_sent += batch.size();
+                counters.bytes_sent += batch.size() * sizeof(RemoteRelaxation);
+                shared.boxes[box(me, to)].swap(batch);
+            }
+            batch.clear();
+        }
+        shared.barrier();
+        incoming.clear();
+        for (int from = 0; from < p; ++from) {
+            auto& box_in = shared.boxes[box(from, me)];
+            incoming.insert(incoming.end(), box_in.begin(), box_in.end());
+            box_in.clear();
+        }
+        // Nobody refills a mailbox before every rank has drained it.
+        shared.barrier();
+        ++counters.sync_rounds;
+    }
+
+    std::uint64_t all_reduce_min(std::uint64_t value) override {
+        shared.slots[static_cast<std::size_t>(me)] = value;
+        shared.barrier();
+        std::uint64_t result = *std::min_element(shared.slots.begin(), shared.slots.end());
+        shared.barrier();
+        ++counters.sync_rounds;
+        return result;
+    }
+
+private:
+    ThreadExchange& shared;
+    int me;
+
+    std::size_t box(int from, int to) const {
+        return static_cast<std::size_t>(from) * static_cast<std::size_t>(shared.ranks) + static_cast<std::size_t>(to);
+    }
+};
+
+// Pins the calling thread to one logical CPU; a no-op where unsupported.
+void pin_current_thread(int cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+// Runs fn(t) on one thread per entry of `cpus`, thread t pinned to cpus[t],
+// and rethrows the first exception.
+template <typename Fn>
+void run_pinned(const std::vector<int>& cpus, Fn&& fn) {
+    std::vector<std::thread> pool;
+    std::vector<std::exception_ptr> errors(cpus.size());
+    for (std::size_t t = 0; t < cpus.size(); ++t) {
+        pool.emplace_back([&, t] {
+            pin_current_thread(cpus[t]);
+            try {
+                fn(t);
+            }
+            catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    for (auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+// Delta-stepping with one thread per rank, each pinned to cpus[rank], over a
+// ThreadTransport: same algorithm and partitioning as the forked version.
+std::vector<std::uint64_t> threaded_delta_stepping(const Graph& graph, int source, std::uint64_t delta,
+    const std::vector<int>& cpus, std::vector<RankStats>* rank_stats = nullptr) {
+    const int ranks = static_cast<int>(cpus.size());
+    const std::size_t chunk = partition_chunk(graph.size(), ranks);
+    ThreadExchange shared(ranks);
+    std::vector<std::uint64_t> dist(graph.size());
+    std::vector<RankStats> stats(cpus.size());
+    run_pinned(cpus, [&](std::size_t r) {
+        ThreadTransport transport(shared, static_cast<int>(r));
+        auto start = std::chrono::steady_clock::now();
+        auto local = delta_stepping_rank(graph, source, delta, transport);
+        std::copy(local.begin(), local.end(),
+            dist.begin() + static_cast<std::ptrdiff_t>(std::min(dist.size(), chunk * r)));
+        transport.stats().elapsed_ms = elapsed_ms(start);
+        stats[r] = transport.stats();
+    });
+    if (rank_stats) {
+        *rank_stats = std::move(stats);
+    }
+    return dist;
+}
+
+// Work split of a hub-parallel run.
+struct HubStats {
+    std::uint64_t pops = 0;
+    std::uint64_t hub_pops = 0;
+    std::uint64_t hub_edges = 0;
+    // Improvements found in hub rows and merged into the queue.
+    std::uint64_t merged = 0;
+    // Edges relaxed by each thread; thread 0 also runs the sequential loop.
+    std::vector<std::uint64_t> thread_edges;
+};
+
+// Default degree above which a row is relaxed in parallel: large enough
+// that waking the helpers (a few microseconds) is repaid.
+std::size_t default_hub_degree(const Graph& graph) {
+    const double avg_degree = graph.empty() ? 0.0
+        : static_cast<double>(graph.edge_count()) / static_cast<double>(graph.size());
+    return std::max<std::size_t>(4096, static_cast<std::size_t>(64.0 * avg_degree));
+}
+
+// Lazy Dijkstra that hands rows of more than `hub_degree` edges to pinned
+// helper threads. The row is cut into chunks claimed from an atomic
+// counter by the helpers and the popping thread alike; each thread checks
+// its edges against dist[] (read-only while the row is shared out) and
+// collects improving (target, distance) pairs in its own buffer. Once all
+// chunks are done, the popping thread merges the buffers, keeping the
+// smallest distance for repeated targets, and pushes them. Rows below the
+// threshold take the usual sequential path.
+template <typename Queue = BinaryHeap>
+std::vector<std::uint64_t> hub_parallel_sssp(const Graph& graph, int source, std::size_t hub_degree,
+    const std::vector<int>& cpus, HubStats* hub_stats = nullptr) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    const std::size_t chunk_edges = 2048;
+    const std::size_t threads = std::max<std::size_t>(1, cpus.size());
+    std::vector<std::uint64_t> dist(graph.size(), INF);
+    dist[source] = 0;
+    HubStats stats;
+    stats.thread_edges.assign(threads, 0);
+    std::vector<std::vector<RemoteRelaxation>> found(threads);
+
+    // The row being shared out; `generation` announces a new one.
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::uint64_t generation = 0;
+    bool stopping = false;
+    const Edge* row = nullptr;
+    std::size_t row_size = 0;
+    std::uint64_t row_distance = 0;
+    std::atomic<std::size_t> next_chunk{ 0 };
+    std::size_t helpers_done = 0;
+    // First failure in a helper; the popping thread rethrows it.
+    std::exception_ptr helper_error;
+
+    auto relax_chunks = [&](std::size_t t) {
+        auto& out = found[t];
+        for (std::size_t c; (c = next_chunk.fetch_add(1)) * chunk_edges < row_size;) {
+            const std::size_t end = std::min(row_size, (c + 1) * chunk_edges);
+            for (std::size_t i = c * chunk_edges; i < end; ++i) {
+                const std::uint64_t nd = row_distance + row[i].weight;
+                if (nd < dist[row[i].to]) {
+                    out.push_back({ nd, row[i].to });
+                }
+            }
+            stats.thread_edges[t] += end - c * chunk_edges;
+        }
+    };
+
+    run_pinned(cpus.empty() ? std::vector<int>{ 0 } : cpus, [&](std::size_t t) {
+        if (t > 0) {
+            std::uint64_t seen = 0;
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [&] { return stopping || generation != seen; });
+                    if (stopping) {
+                        return;
+                    }
+                    seen = generation;
+                }
+                std::exception_ptr error;
+                try {
+                    relax_chunks(t);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++helpers_done;
+                    if (error && !helper_error) {
+                        helper_error = error;
+                    }
+                }
+                finished.notify_one();
+                if (error) {
+                    return;
+                }
+            }
+        }
+
+        // However the popping thread leaves, the helpers must be released.
+        struct StopHelpers {
+            std::mutex& mutex;
+            std::condition_variable& wake;
+            bool& stopping;
+            ~StopHelpers() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                wake.notify_all();
+            }
+        } stop_helpers{ mutex, wake, stopping };
+
+        Queue pq;
+        SettledBitmap settled(graph.size());
+        pq.push(0, source);
+        while (!pq.empty()) {
+            auto [d, u] = pq.pop();
+            if (settled.test(static_cast<std::size_t>(u))) {
+                continue;
+            }
+            settled.set(static_cast<std::size_t>(u));
+            ++stats.pops;
+            const EdgeRange edges = graph[static_cast<std::size_t>(u)];
+            const bool hub = edges.size() > hub_degree;
+            if (hub) {
+                ++stats.hub_pops;
+                stats.hub_edges += edges.size();
+            }
+            if (!hub || threads == 1) {
+                for (const auto& edge : edges) {
+                    std::uint64_t nd = d + edge.weight;
+                    if (nd < dist[edge.to]) {
+                        dist[edge.to] = nd;
+                        pq.push(nd, edge.to);
+                    }
+                }
+                stats.thread_edges[0] += edges.size();
+                continue;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                row = edges.begin();
+                row_size = edges.size();
+                row_distance = d;
+                next_chunk = 0;
+                helpers_done = 0;
+                ++generation;
+            }
+            wake.notify_all();
+            relax_chunks(0);
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                finished.wait(lock, [&] { return helpers_done == threads - 1; });
+                if (helper_error) {
+                    std::rethrow_exception(helper_error);
+                }
+            }
+            for (auto& out : found) {
+                for (const auto& r : out) {
+                    if (r.distance < dist[r.vertex]) {
+                        dist[r.vertex] = r.distance;
+                        pq.push(r.distance, r.vertex);
+                        ++stats.merged;
+                    }
+                }
+                out.clear();
+            }
+        }
+    });
+
+    if (hub_stats) {
+        *hub_stats = std::move(stats);
+    }
+    return dist;
+}
+
+// Smallest incoming and outgoing edge weight of every vertex (INF when it
+// has none), for the Crauser et al. settle criteria.
+struct CrauserBounds {
+    std::vector<std::uint64_t> min_in;
+    std::vector<std::uint64_t> min_out;
+};
+
+CrauserBounds crauser_bounds(const Graph& graph) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    CrauserBounds bounds;
+    bounds.min_in.assign(graph.size(), INF);
+    bounds.min_out.assign(graph.size(), INF);
+    for (std::size_t u = 0; u < graph.size(); ++u) {
+        for (const auto& e : graph[u]) {
+            bounds.min_out[u] = std::min(bounds.min_out[u], e.weight);
+            bounds.min_in[static_cast<std::size_t>(e.to)] = std::min(bounds.min_in[static_cast<std::size_t>(e.to)], e.weight);
+        }
+    }
+    return bounds;
+}
+
+// Phase counts of a Crauser run.
+struct CrauserStats {
+    std::uint64_t phases = 0;
+    std::uint64_t settled = 0;
+    // Vertices only the IN criterion allowed to settle.
+    std::uint64_t settled_by_in_only = 0;
+    std::uint64_t largest_phase = 0;
+    std::vector<std::uint64_t> thread_edges;
+};
+
+// Parallel Dijkstra settling many vertices per phase (Crauser, Mehlhorn,
+// Meyer, Sanders 1998). With L the smallest tentative distance in the
+// queue, a queued vertex v is final when
+//   OUT: dist[v] <= min over queued u of (dist[u] + min_out[u]), or
+//   IN:  dist[v] - min_in[v] <= L,
+// because no path through another queued vertex can still undercut it.
+// Each phase settles every such vertex at once and relaxes their rows in
+// parallel. Queued vertices are owned by thread (v mod threads), which
+// keeps them in three lazy heaps keyed by dist, dist - min_in and
+// dist + min_out, so a phase reads the minima off the tops and pops only
+// the vertices that qualify. A vertex whose distance was lowered reaches
+// its owner once per phase through a per-pair inbox and is pushed with
+// its new distance; entries of settled vertices or of distances since
+// lowered are dropped when they surface. Distances
+// are lowered with an atomic min, and three barriers separate the reduce,
+// settle and relax steps.
+std::vector<std::uint64_t> crauser_sssp(const Graph& graph, int source, const CrauserBounds& bounds,
+    const std::vector<int>& cpus, CrauserStats* crauser_stats = nullptr) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    const std::size_t n = graph.size();
+    const std::vector<int> pinned = cpus.empty() ? std::vector<int>{ 0 } : cpus;
+    const std::size_t threads = pinned.size();
+    auto saturating_add = [INF](std::uint64_t a, std::uint64_t b) { return a > INF - b ? INF : a + b; };
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> dist(new std::atomic<std::uint64_t>[n]);
+    // Set while a vertex sits in some inbox, so it is sent once per phase.
+    std::unique_ptr<std::atomic<std::uint8_t>[]> pending(new std::atomic<std::uint8_t>[n]);
+    for (std::size_t v = 0; v < n; ++v) {
+        dist[v].store(INF, std::memory_order_relaxed);
+        pending[v].store(0, std::memory_order_relaxed);
+    }
+    std::vector<std::uint8_t> settled(n, 0);
+    dist[static_cast<std::size_t>(source)] = 0;
+
+    // Heap keys as a function of the current distance; an entry is live
+    // while its vertex is unsettled and its key still matches.
+    auto by_dist = [](std::size_t, std::uint64_t d) { return d; };
+    auto by_in = [&bounds](std::size_t v, std::uint64_t d) {
+        return d > bounds.min_in[v] ? d - bounds.min_in[v] : 0;
+    };
+    auto by_out = [&bounds, saturating_add](std::size_t v, std::uint64_t d) {
+        return saturating_add(d, bounds.min_out[v]);
+    };
+    using Entry = std::pair<std::uint64_t, int>;
+    using Heap = std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>;
+
+    // inbox[from * threads + owner]
+    std::vector<std::vector<int>> inbox(threads * threads);
+    inbox[static_cast<std::size_t>(source) % threads].push_back(source);
+    std::vector<std::uint64_t> min_dist(threads), min_out_bound(threads), settled_count(threads), in_only(threads);
+    CrauserStats stats;
+    stats.thread_edges.assign(threads, 0);
+    ThreadExchange sync(static_cast<int>(threads));
+
+    run_pinned(pinned, [&](std::size_t t) {
+        Heap dist_heap, in_heap, out_heap;
+        std::vector<int> settling;
+        // Drops dead entries off the top; returns the top key or INF.
+        auto top = [&](Heap& heap, auto key) {
+            while (!heap.empty()) {
+                const std::size_t v = static_cast<std::size_t>(heap.top().second);
+                if (!settled[v] && heap.top().first == key(v, dist[v].load(std::memory_order_relaxed))) {
+                    return heap.top().first;
+                }
+                heap.pop();
+            }
+            return INF;
+        };
+        // Settles live entries while the top key is within the limit.
+        auto settle_up_to = [&](Heap& heap, auto key, std::uint64_t limit) {
+            std::size_t count = 0;
+            while (top(heap, key) <= limit) {
+                const int v = heap.top().second;
+                heap.pop();
+                settled[static_cast<std::size_t>(v)] = 1;
+                settling.push_back(v);
+                ++count;
+            }
+            return count;
+        };
+        for (;;) {
+            for (std::size_t from = 0; from < threads; ++from) {
+                auto& box = inbox[from * threads + t];
+                for (int v : box) {
+                    const std::size_t vi = static_cast<std::size_t>(v);
+                    pending[vi].store(0, std::memory_order_relaxed);
+                    const std::uint64_t d = dist[vi].load(std::memory_order_relaxed);
+                    dist_heap.push({ by_dist(vi, d), v });
+                    in_heap.push({ by_in(vi, d), v });
+                    out_heap.push({ by_out(vi, d), v });
+                }
+                box.clear();
+            }
+            min_dist[t] = top(dist_heap, by_dist);
+            min_out_bound[t] = top(out_heap, by_out);
+            sync.barrier();
+
+            const std::uint64_t L = *std::min_element(min_dist.begin(), min_dist.end());
+            const std::uint64_t out_threshold = *std::min_element(min_out_bound.begin(), min_out_bound.end());
+            if (L == INF) {
+                return;
+            }
+            // OUT first, so the IN pass only finds vertices OUT missed.
+            settling.clear();
+            settle_up_to(dist_heap, by_dist, out_threshold);
+            in_only[t] = settle_up_to(in_heap, by_in, L);
+            settled_count[t] = settling.size();
+            sync.barrier();
+
+            if (t == 0) {
+                const std::uint64_t phase = std::accumulate(settled_count.begin(), settled_count.end(), std::uint64_t{ 0 });
+                ++stats.phases;
+                stats.settled += phase;
+                stats.settled_by_in_only += std::accumulate(in_only.begin(), in_only.end(), std::uint64_t{ 0 });
+                stats.largest_phase = std::max(stats.largest_phase, phase);
+            }
+            for (int u : settling) {
+                const std::uint64_t du = dist[static_cast<std::size_t>(u)].load(std::memory_order_relaxed);
+                const EdgeRange row = graph[static_cast<std::size_t>(u)];
+                stats.thread_edges[t] += row.size();
+                for (const auto& edge : row) {
+                    const std::size_t to = static_cast<std::size_t>(edge.to);
+                    if (settled[to]) {
+                        continue;
+                    }
+                    const std::uint64_t nd = du + edge.weight;
+                    std::uint64_t current = dist[to].load(std::memory_order_relaxed);
+                    while (nd < current && !dist[to].compare_exchange_weak(current, nd, std::memory_order_relaxed)) {
+                    }
+                    if (nd < current && pending[to].exchange(1, std::memory_order_relaxed) == 0) {
+                        inbox[t * threads + to % threads].push_back(edge.to);
+                    }
+                }
+            }
+            sync.barrier();
+        }
+    });
+
+    std::vector<std::uint64_t> result(n);
+    for (std::size_t v = 0; v < n; ++v) {
+        result[v] = dist[v].load(std::memory_order_relaxed);
+    }
+    if (crauser_stats) {
+        *crauser_stats = std::move(stats);
+    }
+    return result;
+}
+
+// Logical CPUs in the order scaling runs add threads: one per physical core,
+// socket by socket, then the SMT siblings. Only CPUs this process may run on
+// are listed.
+struct CpuTopology {
+    std::vector<int> order;
+    int sockets = 1;
+    int cores = 1;
+};
+
+CpuTopology read_cpu_topology() {
+    CpuTopology topology;
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        // (socket, core) -> logical CPUs on that core.
+        std::map<std::pair<int, int>, std::vector<int>> cores;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, &allowed)) {
+                continue;
+            }
+            const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            int socket = 0, core = cpu;
+            std::ifstream(dir + "physical_package_id") >> socket;
+            std::ifstream(dir + "core_id") >> core;
+            cores[{ socket, core }].push_back(cpu);
+        }
+        std::map<int, int> sockets;
+        for (std::size_t level = 0; !cores.empty(); ++level) {
+            bool any = false;
+            for (const auto& [key, cpus] : cores) {
+                if (level < cpus.size()) {
+                    topology.order.push_back(cpus[level]);
+                    sockets[key.first] = 1;
+                    any = true;
+                }
+            }
+            if (!any) {
+                break;
+            }
+        }
+        topology.sockets = static_cast<int>(std::max<std::size_t>(1, sockets.size()));
+        topology.cores = static_cast<int>(std::max<std::size_t>(1, cores.size()));
+    }
+#endif
+    if (topology.order.empty()) {
+        const int logical = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        for (int cpu = 0; cpu < logical; ++cpu) {
+            topology.order.push_back(cpu);
+        }
+        topology.cores = logical;
+    }
+    return topology;
+}
+
+// One run of a parallel engine at some thread count.
+struct ParallelRun {
+    // Distances from the harness source, checked against Dijkstra.
+    std::vector<std::uint64_t> distances;
+    // Edges relaxed by each thread.
+    std::vector<std::uint64_t> thread_work;
+    // Estimated bytes the run moved to and from memory.
+    std::uint64_t bytes_moved = 0;
+};
+
+// An engine the scaling harness can run on any list of pinned CPUs.
+struct ParallelEngine {
+    std::string name;
+    std::string description;
+    std::function<ParallelRun(const Graph&, int source, const std::vector<int>& cpus)> run;
+};
+
+// Bytes a relaxation-driven run touches: each relaxed edge is read and its
+// target's distance loaded; each settled vertex reads two offsets and moves
+// one heap entry in and out.
+std::uint64_t estimate_bytes_moved(std::uint64_t relaxations, std::uint64_t pops) {
+    return relaxations * (sizeof(Edge) + sizeof(std::uint64_t))
+        + pops * (2 * sizeof(std::uint64_t) + 2 * 16);
+}
+
+// Sources for multi-source runs: the harness source plus evenly spaced others.
+std::vector<int> scaling_sources(const Graph& graph, int source, std::size_t count) {
+    std::vector<int> sources{ source };
+    for (std::size_t i = 1; i < count; ++i) {
+        sources.push_back(static_cast<int>((static_cast<std::size_t>(source) + i * graph.size() / count) % graph.size()));
+    }
+    return sources;
+}
+
+// Parallel engines selectable with --scaling=<name>. New parallel modes
+// register here to get the scaling report for free.
+std::vector<ParallelEngine> parallel_engines() {
+    std::vector<ParallelEngine> engines;
+    engines.push_back({ "delta-threads", "delta-stepping, one pinned thread per vertex block",
+        [](const Graph& graph, int source, const std::vector<int>& cpus) {
+            std::vector<RankStats> stats;
+            ParallelRun run;
+            run.distances = threaded_delta_stepping(graph, source, default_delta(graph), cpus, &stats);
+            std::uint64_t total = 0;
+            for (const auto& s : stats) {
+                run.thread_work.push_back(s.edge_relaxations);
+                total += s.edge_relaxations;
+            }
+            run.bytes_moved = estimate_bytes_moved(total, graph.size())
+                + std::accumulate(stats.begin(), stats.end(), std::uint64_t{ 0 },
+                    [](std::uint64_t sum, const RankStats& s) { return sum + 2 * s.bytes_sent; });
+            return run;
+        } });
+    engines.push_back({ "hub-threads", "Dijkstra relaxing rows above the hub degree in parallel chunks",
+        [](const Graph& graph, int source, const std::vector<int>& cpus) {
+            HubStats stats;
+            ParallelRun run;
+            run.distances = hub_parallel_sssp(graph, source, default_hub_degree(graph), cpus, &stats);
+            run.thread_work = stats.thread_edges;
+            run.bytes_moved = estimate_bytes_moved(
+                std::accumulate(run.thread_work.begin(), run.thread_work.end(), std::uint64_t{ 0 }), stats.pops);
+            return run;
+        } });
+    engines.push_back({ "crauser", "multi-settle Dijkstra with the IN/OUT criteria, bounds computed per run",
+        [](const Graph& graph, int source, const std::vector<int>& cpus) {
+            CrauserStats stats;
+            ParallelRun run;
+            run.distances = crauser_sssp(graph, source, crauser_bounds(graph), cpus, &stats);
+            run.thread_work = stats.thread_edges;
+            run.bytes_moved = estimate_bytes_moved(
+                std::accumulate(run.thread_work.begin(), run.thread_work.end(), std::uint64_t{ 0 }), stats.settled);
+            return run;
+        } });
+    engines.push_back({ "multi-source", "16 radix-heap SSSP queries shared out among the threads",
+        [](const Graph& graph, int source, const std::vector<int>& cpus) {
+            const std::vector<int> sources = scaling_sources(graph, source, 16);
+            ParallelRun run;
+            run.thread_work.assign(cpus.size(), 0);
+            std::vector<std::uint64_t> pops(cpus.size(), 0);
+            std::atomic<std::size_t> next{ 0 };
+            run_pinned(cpus, [&](std::size_t t) {
+                for (std::size_t i; (i = next.fetch_add(1)) < sources.size();) {
+                    SsspCounters counters;
+                    auto dist = lazy_sssp<RadixHeap>(graph, sources[i], &counters);
+                    run.thread_work[t] += counters.relaxations;
+                    pops[t] += counters.pops;
+                    if (i == 0) {
+                        run.distances = std::move(dist);
+                    }
+                }
+            });
+            run.bytes_moved = estimate_bytes_moved(
+                std::accumulate(run.thread_work.begin(), run.thread_work.end(), std::uint64_t{ 0 }),
+                std::accumulate(pops.begin(), pops.end(), std::uint64_t{ 0 }));
+            return run;
+        } });
+    return engines;
+}
+
+// Per-thread state for bounded queries run back to back. Distances and
+// settled bits are cleared through the list of vertices the last query
+// touched, so a query costs its own region instead of O(n), and the arrays
+// stay cached between neighbouring queries.
+class BoundedSearch {
+public:
+    struct Summary {
+        std::uint64_t reached = 0;
+        std::uint64_t farthest = 0;
+        std::uint64_t relaxations = 0;
+    };
+
+    explicit BoundedSearch(std::size_t n)
+        : dist(n, std::numeric_limits<std::uint64_t>::max()), settled(n) {}
+
+    Summary run(const Graph& graph, int source, std::uint64_t bound) {
+        const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+        for (int v : touched) {
+            dist[static_cast<std::size_t>(v)] = INF;
+            settled.reset(static_cast<std::size_t>(v));
+        }
+        touched.clear();
+
+        Summary summary;
+        RadixHeap pq;
+        dist[static_cast<std::size_t>(source)] = 0;
+        touched.push_back(source);
+        pq.push(0, source);
+        while (!pq.empty()) {
+            auto [d, u] = pq.pop();
+            if (settled.test(static_cast<std::size_t>(u))) {
+                continue;
+            }
+            settled.set(static_cast<std::size_t>(u));
+            ++summary.reached;
+            summary.farthest = d;
+            for (const auto& edge : graph[u]) {
+                ++summary.relaxations;
+                std::uint64_t nd = d + edge.weight;
+                if (nd <= bound && nd < dist[edge.to]) {
+                    if (dist[edge.to] == INF) {
+                        touched.push_back(edge.to);
+                    }
+                    dist[edge.to] = nd;
+                    pq.push(nd, edge.to);
+                }
+            }
+        }
+        return summary;
+    }
+
+private:
+    std::vector<std::uint64_t> dist;
+    SettledBitmap settled;
+    std::vector<int> touched;
+};
+
+// Rank of every vertex in a breadth-first sweep (restarted at the lowest
+// unvisited id), so vertices a few hops apart get close ranks whatever the
+// input numbering.
+std::vector<std::uint32_t> bfs_ranks(const Graph& graph) {
+    const std::uint32_t unseen = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> rank(graph.size(), unseen);
+    std::vector<int> frontier;
+    std::uint32_t next = 0;
+    for (std::size_t root = 0; root < graph.size(); ++root) {
+        if (rank[root] != unseen) {
+            continue;
+        }
+        rank[root] = next++;
+        frontier.assign(1, static_cast<int>(root));
+        for (std::size_t head = 0; head < frontier.size(); ++head) {
+            for (const auto& edge : graph[frontier[head]]) {
+                if (rank[static_cast<std::size_t>(edge.to)] == unseen) {
+                    rank[static_cast<std::size_t>(edge.to)] = next++;
+                    frontier.push_back(edge.to);
+                }
+            }
+        }
+    }
+    return rank;
+}
+
+// How a query batch is handed to the threads.
+enum class BatchOrder { fifo, vertex_id, bfs_rank };
+
+struct BatchResult {
+    double ms = 0.0;
+    // Sum over queries of vertices reached, to check the orders agree.
+    std::uint64_t reached = 0;
+    std::uint64_t relaxations = 0;
+};
+
+// Runs bounded queries from `sources` on pinned threads. FIFO threads take
+// the next pending query in submission order. The locality orders sort the
+// batch by vertex id or BFS rank and give each thread one contiguous run,
+// so neighbouring queries land on the same core and reuse its caches.
+BatchResult run_query_batch(const Graph& graph, std::vector<int> sources, std::uint64_t bound,
+    const std::vector<int>& cpus, BatchOrder order, const std::vector<std::uint32_t>& ranks) {
+    if (order == BatchOrder::vertex_id) {
+        std::sort(sources.begin(), sources.end());
+    }
+    else if (order == BatchOrder::bfs_rank) {
+        std::sort(sources.begin(), sources.end(), [&](int a, int b) {
+            return ranks[static_cast<std::size_t>(a)] < ranks[static_cast<std::size_t>(b)];
+        });
+    }
+    const std::size_t threads = cpus.size();
+    std::vector<BatchResult> per_thread(threads);
+    std::atomic<std::size_t> next{ 0 };
+    auto start = std::chrono::steady_clock::now();
+    run_pinned(cpus, [&](std::size_t t) {
+        BoundedSearch search(graph.size());
+        auto run_one = [&](std::size_t i) {
+            const auto summary = search.run(graph, sources[i], bound);
+            per_thread[t].reached += summary.reached;
+            per_thread[t].relaxations += summary.relaxations;
+        };
+        if (order == BatchOrder::fifo) {
+            for (std::size_t i; (i = next.fetch_add(1)) < sources.size();) {
+                run_one(i);
+            }
+        }
+        else {
+            const std::size_t begin = sources.size() * t / threads;
+            const std::size_t end = sources.size() * (t + 1) / threads;
+            for (std::size_t i = begin; i < end; ++i) {
+                run_one(i);
+            }
+        }
+    });
+    BatchResult result;
+    result.ms = elapsed_ms(start);
+    for (const auto& r : per_thread) {
+        result.reached += r.reached;
+        result.relaxations += r.relaxations;
+    }
+    return result;
+}
+
+// Throughput of one batch of bounded queries under FIFO and locality-aware
+// scheduling. Sources are drawn pseudo-randomly; the default bound is the
+// distance at which a query from `source` has settled about 1000 vertices.
+void run_batch_report(const Graph& graph, int source, std::size_t count,
+    std::optional<std::uint64_t> bound, int runs) {
+    if (!bound) {
+        SettleOrderIterator it(graph, source);
+        std::uint64_t reach = 0;
+        for (std::size_t i = 0; i < 1000; ++i) {
+            auto settled = it.next();
+            if (!settled) {
+                break;
+            }
+            reach = settled->distance;
+        }
+        bound = reach;
+    }
+
+    std::vector<int> sources(count);
+    std::uint64_t state = 0x2545f4914f6cdd1dull;
+    for (auto& s : sources) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        s = static_cast<int>(state % graph.size());
+    }
+    const std::vector<std::uint32_t> ranks = bfs_ranks(graph);
+    const std::vector<int> cpus = read_cpu_topology().order;
+
+    std::cout << "Query batch: " << count << " bounded queries (bound " << *bound << ") on "
+        << cpus.size() << " thread(s), best of " << runs << " run(s)" << std::endl;
+    const std::pair<BatchOrder, const char*> orders[] = {
+        { BatchOrder::fifo, "FIFO order" },
+        { BatchOrder::vertex_id, "Vertex id order" },
+        { BatchOrder::bfs_rank, "BFS rank order" },
+    };
+    double fifo_ms = 0.0;
+    std::uint64_t fifo_reached = 0;
+    for (const auto& [order, name] : orders) {
+        BatchResult best;
+        best.ms = std::numeric_limits<double>::infinity();
+        for (int r = 0; r < runs; ++r) {
+            BatchResult result = run_query_batch(graph, sources, *bound, cpus, order, ranks);
+            if (result.ms < best.ms) {
+                best = result;
+            }
+        }
+        if (order == BatchOrder::fifo) {
+            fifo_ms = best.ms;
+            fifo_reached = best.reached;
+        }
+        else if (best.reached != fifo_reached) {
+            throw std::runtime_error(std::string(name) + " reached a different number of vertices than FIFO");
+        }
+        std::cout << std::setw(30) << std::left << name << ": " << std::fixed << std::setprecision(3)
+            << best.ms << " ms, " << std::setprecision(0)
+            << static_cast<double>(count) * 1000.0 / best.ms << " queries/s, "
+            << best.relaxations << " relaxations";
+        if (order != BatchOrder::fifo) {
+            std::cout << " (" << std::setprecision(2) << fifo_ms / best.ms << "x FIFO)";
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Serialises response lines from worker threads onto one stream. Shared by
+// the server and by graph snapshots, which report their own release.
+class ServerOutput {
+public:
+    explicit ServerOutput(std::ostream& out) : out(out) {}
+
+    void line(const std::string& text) {
+        std::lock_guard<std::mutex> lock(mutex);
+        out << text << std::endl;
+    }
+
+private:
+    std::mutex mutex;
+    std::ostream& out;
+};
+
+// One immutable version of the served graph. Queries pin the snapshot they
+// started on through a shared_ptr; when a reload retires it, the last
+// finishing query frees it.
+struct GraphSnapshot {
+    GraphLoadResult loaded;
+    std::uint64_t version = 0;
+    std::size_t bytes = 0;
+    // Set when a newer snapshot replaces this one.
+    mutable std::atomic<std::int64_t> retired_at_ns{ 0 };
+};
+
+std::size_t graph_bytes(const Graph& graph) {
+    return (graph.size() + 1) * sizeof(std::uint64_t) + graph.edge_count() * sizeof(Edge);
+}
+
+std::int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Log-linear latency histogram in the HDR style: every power-of-two range
+// of microseconds is split into 4 sub-buckets, so a recorded latency is
+// within 25% of its bucket's bound, from 1 us up to about 2^26 us (67 s);
+// longer ones land in the last bucket. One thread writes an instance and
+// scrapes read it, both with relaxed atomics.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 2;
+    static constexpr std::uint64_t kSub = std::uint64_t{ 1 } << kSubBits;
+    static constexpr int kMaxExponent = 26;
+    static constexpr std::size_t kBuckets = static_cast<std::size_t>((kMaxExponent - kSubBits + 2) * kSub);
+
+    void record(std::uint64_t micros) {
+        bump(counts[bucket(micros)], 1);
+        bump(total_micros, micros);
+    }
+
+    // Largest whole number of microseconds bucket `i` holds.
+    static std::uint64_t upper_micros(std::size_t i) {
+        if (i < kSub) {
+            return i;
+        }
+        const int exponent = static_cast<int>(i / kSub) + kSubBits - 1;
+        return ((kSub + i % kSub + 1) << (exponent - kSubBits)) - 1;
+    }
+
+    std::uint64_t count(std::size_t i) const { return counts[i].load(std::memory_order_relaxed); }
+    std::uint64_t sum_micros() const { return total_micros.load(std::memory_order_relaxed); }
+
+    // Single-writer increment: no read-modify-write instruction needed.
+    static void bump(std::atomic<std::uint64_t>& counter, std::uint64_t by) {
+        counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::uint64_t> counts[kBuckets] = {};
+    std::atomic<std::uint64_t> total_micros{ 0 };
+
+    static std::size_t bucket(std::uint64_t v) {
+        if (v < kSub) {
+            return static_cast<std::size_t>(v);
+        }
+        const int exponent = 63 - __builtin_clzll(v);
+        if (exponent > kMaxExponent) {
+            return kBuckets - 1;
+        }
+        return static_cast<std::size_t>((exponent - kSubBits + 1) * kSub + ((v >> (exponent - kSubBits)) & (kSub - 1)));
+    }
+};
+
+// Server request kinds and outcomes, and the engines behind them, as
+// metric label values.
+constexpr const char* kMetricCommands[] = { "query", "distance" };
+constexpr const char* kMetricOutcomes[] = { "ok", "partial", "error" };
+constexpr const char* kMetricEngines[] = { "radix", "bounded", "budgeted" };
+
+// Counters of one query worker, on their own cache lines so workers never
+// share one. Only that worker writes them; a scrape sums all workers.
+struct alignas(kCacheLineBytes) WorkerMetrics {
+    std::atomic<std::uint64_t> requests[2][3] = {};
+    std::atomic<std::uint64_t> engine_runs[3] = {};
+    std::atomic<std::uint64_t> engine_settled[3] = {};
+    std::atomic<std::uint64_t> engine_relaxations[3] = {};
+    // Time from reading a request to writing its answer.
+    LatencyHistogram latency[2];
+};
+
+// Serves GET requests on a local socket with the text `body()` returns, as
+// a Prometheus scrape target. `spec` is unix:<path> or tcp:[<host>:]<port>
+// (host defaults to 127.0.0.1). Connections are answered one at a time on
+// a background thread until the endpoint is destroyed.
+class MetricsEndpoint {
+public:
+    MetricsEndpoint(const std::string& spec, std::function<std::string()> body) : body(std::move(body)) {
+#if defined(__unix__)
+        if (spec.rfind("unix:", 0) == 0) {
+            unix_path = spec.substr(5);
+            sockaddr_un addr{};
+            if (unix_path.empty() || unix_path.size() >= sizeof(addr.sun_path)) {
+                throw std::runtime_error("Bad metrics socket path: " + unix_path);
+            }
+            addr.sun_family = AF_UNIX;
+            std::memcpy(addr.sun_path, unix_path.c_str(), unix_path.size() + 1);
+            remove_stale_socket(addr);
+            fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            listen_on(reinterpret_cast<const sockaddr*>(&addr), sizeof(addr), spec);
+            // Remember which inode is ours, so shutdown removes only it.
+            struct stat info {};
+            if (::lstat(unix_path.c_str(), &info) == 0) {
+                socket_id = { info.st_dev, info.st_ino };
+            }
+        }
+        else if (spec.rfind("tcp:", 0) == 0) {
+            const std::string rest = spec.substr(4);
+            const auto colon = rest.rfind(':');
+            const std::string host = colon == std::string::npos ? "127.0.0.1" : rest.substr(0, colon);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(static_cast<std::uint16_t>(parse_number<std::uint16_t>("--metrics port", rest.substr(colon == std::string::npos ? 0 : colon + 1))));
+            if (::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+                throw std::runtime_error("Bad metrics host: " + host);
+            }
+            fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            const int on = 1;
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            listen_on(reinterpret_cast<const sockaddr*>(&addr), sizeof(addr), spec);
+        }
+        else {
+            throw std::runtime_error("--metrics needs unix:<path> or tcp:[<host>:]<port>, got " + spec);
+        }
+        server = std::thread([this] { serve(); });
+#else
+        (void)spec;
+        throw std::runtime_error("--metrics needs a POSIX system");
+#endif
+    }
+
+    ~MetricsEndpoint() {
+        stop = true;
+        if (server.joinable()) {
+            server.join();
+        }
+#if defined(__unix__)
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        struct stat info {};
+        if (socket_id && ::lstat(unix_path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)
+            && std::make_pair(info.st_dev, info.st_ino) == *socket_id) {
+            ::unlink(unix_path.c_str());
+        }
+#endif
+    }
+
+    MetricsEndpoint(const MetricsEndpoint&) = delete;
+    MetricsEndpoint& operator=(const MetricsEndpoint&) = delete;
+
+private:
+    std::function<std::string()> body;
+    std::string unix_path;
+#if defined(__unix__)
+    // Device and inode of the socket this endpoint bound.
+    std::optional<std::pair<dev_t, ino_t>> socket_id;
+#endif
+    int fd = -1;
+    std::atomic<bool> stop{ false };
+    std::thread server;
+
+#if defined(__unix__)
+    // Only a socket nobody listens on may be replaced; any other file at
+    // the path is refused.
+    void remove_stale_socket(const sockaddr_un& addr) {
+        struct stat info {};
+        if (::lstat(unix_path.c_str(), &info) != 0) {
+            return;
+        }
+        if (!S_ISSOCK(info.st_mode)) {
+            throw std::runtime_error("Refusing to replace " + unix_path + ": not a socket");
+        }
+        const int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        const bool live = probe >= 0 && ::connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+        if (probe >= 0) {
+            ::close(probe);
+        }
+        if (live) {
+            throw std::runtime_error("Metrics socket " + unix_path + " is in use");
+        }
+        ::unlink(unix_path.c_str());
+    }
+
+    void listen_on(const sockaddr* addr, socklen_t length, const std::string& spec) {
+        if (fd < 0 || ::bind(fd, addr, length) != 0 || ::listen(fd, 16) != 0) {
+            const std::string reason = std::strerror(errno);
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            throw std::runtime_error("Failed to listen on " + spec + ": " + reason);
+        }
+    }
+
+    void serve() {
+        while (!stop) {
+            pollfd waiting{ fd, POLLIN, 0 };
+            if (::poll(&waiting, 1, 200) <= 0) {
+                continue;
+            }
+            const int client = ::accept(fd, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+            // Drain the request head; any GET is answered with the metrics.
+            timeval timeout{ 0, 200000 };
+            ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            char request[4096];
+            (void)::recv(client, request, sizeof(request), 0);
+            const std::string text = body();
+            const std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                "Content-Length: " + std::to_string(text.size()) + "\r\nConnection: close\r\n\r\n" + text;
+            for (std::size_t sent = 0; sent < response.size();) {
+                const ssize_t n = ::send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    break;
+                }
+                sent += static_cast<std::size_t>(n);
+            }
+            ::close(client);
+        }
+    }
+#endif
+};
+
+enum class CoalesceMode { off, exact, overlap };
+
+// A query some worker is computing, and the requests waiting on its result.
+struct InFlightQuery {
+    struct Waiter {
+        std::uint64_t id;
+        std::uint64_t bound;
+        std::chrono::steady_clock::time_point received;
+    };
+
+    std::uint64_t version = 0;
+    int source = 0;
+    std::uint64_t bound = 0;
+    std::vector<Waiter> waiters;
+};
+
+// Reads the optional trailing bound of a query line: nullopt when the line
+// ends, an error for anything but one non-negative integer.
+std::optional<std::uint64_t> read_query_bound(std::istream& in) {
+    std::string token;
+    if (!(in >> token)) {
+        return std::nullopt;
+    }
+    const char* p = token.c_str();
+    long long bound = -1;
+    if (!parse_integer(p, token.c_str() + token.size(), bound) || bound < 0) {
+        throw std::runtime_error("bad bound: " + token);
+    }
+    if (in >> token) {
+        throw std::runtime_error("unexpected text after the bound: " + token);
+    }
+    return static_cast<std::uint64_t>(bound);
+}
+
+// "reached=<n> max=<d>" over the distances within `bound`.
+std::string query_summary(const std::vector<std::uint64_t>& dist, std::uint64_t bound) {
+    std::size_t reached = 0;
+    std::uint64_t farthest = 0;
+    for (std::uint64_t d : dist) {
+        if (d <= bound && d != std::numeric_limits<std::uint64_t>::max()) {
+            ++reached;
+            farthest = std::max(farthest, d);
+        }
+    }
+    return "reached=" + std::to_string(reached) + " max=" + std::to_string(farthest);
+}
+
+struct ServerConfig {
+    int workers = 1;
+    LoadOptions load;
+    // Sort adjacency rows of every loaded snapshot by weight.
+    bool sort_adjacency = false;
+    // Per-request budget, measured from when the request was read; queries
+    // that exceed it answer with the settled part and a lower bound.
+    std::optional<double> deadline_ms;
+    std::uint64_t work_budget = 0;
+    // Let a query join an identical one already running ("exact"), or any
+    // running query from the same source with a bound at least as large
+    // ("overlap"), instead of computing it again.
+    CoalesceMode coalesce = CoalesceMode::off;
+    // Prometheus endpoint (unix:<path> or tcp:[<host>:]<port>); empty = none.
+    std::string metrics;
+};
+
+// Long-lived query mode. Reads one command per line from `in`, runs queries
+// on a pool of worker threads and answers "<id> ok ..." or "<id> error ...",
+// where <id> is the command's line number:
+//
+//   query <source> [bound]       distances from source (optionally bounded)
+//   distance <source> <target>   point-to-point distance
+//   reload <input>               load a new graph in the background and swap it in
+//   stats                        coalescing counters
+//   quit                         stop reading; in-flight work still completes
+//
+// With coalescing on, a query for a source that is already being computed
+// on the same snapshot registers as a waiter and frees its worker; the
+// computing worker answers every waiter from its result, tagged
+// "coalesced=<id>" with the id of the request that ran.
+//
+// With a metrics endpoint configured, each worker counts its requests,
+// latencies and engine work in its own WorkerMetrics; a scrape sums them
+// and adds queue depth, coalescing and memory gauges.
+//
+// With a deadline or work budget configured, query and distance answers
+// that run out of it end in "partial lower_bound=<d>": the reported numbers
+// cover the settled region only, and every other vertex is at least <d>
+// away.
+//
+// The current snapshot is swapped with an atomic shared_ptr store, RCU style:
+// queries that already hold the old snapshot finish on it, new queries see
+// the new one, and the old graph is freed once the last reader drops it.
+class QueryServer {
+public:
+    QueryServer(GraphLoadResult initial, const ServerConfig& config, std::ostream& out)
+        : config(config), output(std::make_shared<ServerOutput>(out)) {
+        current = make_snapshot(std::move(initial));
+        for (int i = 0; i < std::max(1, config.workers); ++i) {
+            worker_metrics.push_back(std::make_unique<WorkerMetrics>());
+        }
+    }
+
+    void run(std::istream& in) {
+        std::unique_ptr<MetricsEndpoint> endpoint;
+        if (!config.metrics.empty()) {
+            endpoint = std::make_unique<MetricsEndpoint>(config.metrics, [this] { return metrics_text(); });
+            output->line("* metrics on " + config.metrics);
+        }
+        std::vector<std::thread> pool;
+        for (std::size_t i = 0; i < worker_metrics.size(); ++i) {
+            pool.emplace_back([this, i] { worker_loop(i); });
+        }
+
+        std::string line;
+        std::uint64_t id = 0;
+        while (std::getline(in, line)) {
+            ++id;
+            std::istringstream iss(line);
+            std::string command;
+            if (!(iss >> command)) {
+                continue;
+            }
+            if (command == "quit") {
+                break;
+            }
+            if (command == "reload") {
+                std::string spec;
+                iss >> spec;
+                start_reload(id, spec);
+            }
+            else if (command == "query" || command == "distance") {
+                submit(id, command, line);
+            }
+            else if (command == "stats") {
+                output->line(std::to_string(id) + " ok stats " + coalescing_stats());
+            }
+            else {
+                output->line(std::to_string(id) + " error unknown command: " + command);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        queue_ready.notify_all();
+        for (auto& worker : pool) {
+            worker.join();
+        }
+        if (reloader.joinable()) {
+            reloader.join();
+        }
+        if (config.coalesce != CoalesceMode::off) {
+            output->line("* coalescing: " + coalescing_stats());
+        }
+    }
+
+private:
+    ServerConfig config;
+    std::shared_ptr<ServerOutput> output;
+    std::shared_ptr<const GraphSnapshot> current;
+    std::atomic<std::uint64_t> next_version{ 1 };
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_ready;
+    // Each task receives the index of the worker running it.
+    std::deque<std::function<void(std::size_t)>> tasks;
+    bool stopping = false;
+
+    std::thread reloader;
+    std::atomic<bool> reloading{ false };
+
+    std::vector<std::unique_ptr<WorkerMetrics>> worker_metrics;
+
+    std::mutex flight_mutex;
+    std::vector<std::shared_ptr<InFlightQuery>> in_flight;
+    std::atomic<std::uint64_t> queries_computed{ 0 };
+    std::atomic<std::uint64_t> coalesced_exact{ 0 };
+    std::atomic<std::uint64_t> coalesced_overlap{ 0 };
+
+    static void count_engine(WorkerMetrics& metrics, std::size_t engine, std::uint64_t settled,
+        std::uint64_t relaxations) {
+        LatencyHistogram::bump(metrics.engine_runs[engine], 1);
+        LatencyHistogram::bump(metrics.engine_settled[engine], settled);
+        LatencyHistogram::bump(metrics.engine_relaxations[engine], relaxations);
+    }
+
+    static void record_request(WorkerMetrics& metrics, std::size_t kind, std::size_t outcome,
+        std::chrono::steady_clock::time_point received) {
+        LatencyHistogram::bump(metrics.requests[kind][outcome], 1);
+        metrics.latency[kind].record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - received).count()));
+    }
+
+    // Prometheus text exposition of the per-worker counters, summed here,
+    // plus gauges read at scrape time.
+    std::string metrics_text() {
+        auto sum = [&](auto field) {
+            std::uint64_t total = 0;
+            for (const auto& m : worker_metrics) {
+                total += field(*m).load(std::memory_order_relaxed);
+            }
+            return total;
+        };
+        std::ostringstream out;
+        out << "# HELP sssp_requests_total Requests answered, by command and outcome.\n"
+            << "# TYPE sssp_requests_total counter\n";
+        for (std::size_t c = 0; c < 2; ++c) {
+            for (std::size_t o = 0; o < 3; ++o) {
+                out << "sssp_requests_total{command=\"" << kMetricCommands[c] << "\",outcome=\""
+                    << kMetricOutcomes[o] << "\"} "
+                    << sum([&](WorkerMetrics& m) -> std::atomic<std::uint64_t>& { return m.requests[c][o]; }) << "\n";
+            }
+        }
+
+        out << "# HELP sssp_request_latency_seconds Time from reading a request to answering it.\n"
+            << "# TYPE sssp_request_latency_seconds histogram\n";
+        for (std::size_t c = 0; c < 2; ++c) {
+            std::uint64_t cumulative = 0;
+            std::uint64_t sum_micros = 0;
+            for (const auto& m : worker_metrics) {
+                sum_micros += m->latency[c].sum_micros();
+            }
+            for (std::size_t i = 0; i < LatencyHistogram::kBuckets; ++i) {
+                for (const auto& m : worker_metrics) {
+                    cumulative += m->latency[c].count(i);
+                }
+                if (i + 1 == LatencyHistogram::kBuckets) {
+                    break;
+                }
+                out << "sssp_request_latency_seconds_bucket{command=\"" << kMetricCommands[c] << "\",le=\""
+                    << static_cast<double>(LatencyHistogram::upper_micros(i) + 1) / 1e6 << "\"} " << cumulative << "\n";
+            }
+            out << "sssp_request_latency_seconds_bucket{command=\"" << kMetricCommands[c] << "\",le=\"+Inf\"} "
+                << cumulative << "\n"
+                << "sssp_request_latency_seconds_sum{command=\"" << kMetricCommands[c] << "\"} "
+                << static_cast<double>(sum_micros) / 1e6 << "\n"
+                << "sssp_request_latency_seconds_count{command=\"" << kMetricCommands[c] << "\"} "
+                << cumulative << "\n";
+        }
+
+        const std::pair<const char*, std::atomic<std::uint64_t>(WorkerMetrics::*)[3]> engine_counters[] = {
+            { "sssp_engine_runs_total", &WorkerMetrics::engine_runs },
+            { "sssp_engine_settled_vertices_total", &WorkerMetrics::engine_settled },
+            { "sssp_engine_relaxations_total", &WorkerMetrics::engine_relaxations },
+        };
+        for (const auto& [name, field] : engine_counters) {
+            out << "# TYPE " << name << " counter\n";
+            for (std::size_t e = 0; e < 3; ++e) {
+                out << name << "{engine=\"" << kMetricEngines[e] << "\"} "
+                    << sum([&](WorkerMetrics& m) -> std::atomic<std::uint64_t>& { return (m.*field)[e]; }) << "\n";
+            }
+        }
+
+        std::size_t queued = 0;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            queued = tasks.size();
+        }
+        std::size_t running = 0;
+        {
+            std::lock_guard<std::mutex> lock(flight_mutex);
+            running = in_flight.size();
+        }
+        const std::uint64_t computed = queries_computed.load();
+        const std::uint64_t exact = coalesced_exact.load();
+        const std::uint64_t overlap = coalesced_overlap.load();
+        std::shared_ptr<const GraphSnapshot> snap = snapshot();
+        out << "# HELP sssp_queue_depth Requests waiting for a worker.\n# TYPE sssp_queue_depth gauge\n"
+            << "sssp_queue_depth " << queued << "\n"
+            << "# TYPE sssp_workers gauge\nsssp_workers " << worker_metrics.size() << "\n"
+            << "# HELP sssp_coalescing_in_flight Shareable queries queued or being computed.\n"
+            << "# TYPE sssp_coalescing_in_flight gauge\nsssp_coalescing_in_flight " << running << "\n"
+            << "# TYPE sssp_queries_computed_total counter\nsssp_queries_computed_total " << computed << "\n"
+            << "# TYPE sssp_coalesced_requests_total counter\n"
+            << "sssp_coalesced_requests_total{kind=\"exact\"} " << exact << "\n"
+            << "sssp_coalesced_requests_total{kind=\"overlap\"} " << overlap << "\n"
+            << "# HELP sssp_coalescing_hit_ratio Share of queries answered from another request's run.\n"
+            << "# TYPE sssp_coalescing_hit_ratio gauge\nsssp_coalescing_hit_ratio "
+            << (computed + exact + overlap == 0 ? 0.0
+                : static_cast<double>(exact + overlap) / static_cast<double>(computed + exact + overlap)) << "\n"
+            << "# TYPE sssp_resident_memory_bytes gauge\nsssp_resident_memory_bytes " << current_rss_bytes() << "\n"
+            << "# TYPE sssp_peak_resident_memory_bytes gauge\nsssp_peak_resident_memory_bytes " << peak_rss_bytes() << "\n"
+            << "# TYPE sssp_graph_bytes gauge\nsssp_graph_bytes " << snap->bytes << "\n"
+            << "# TYPE sssp_graph_version gauge\nsssp_graph_version " << snap->version << "\n";
+        return out.str();
+    }
+
+    std::string coalescing_stats() const {
+        const std::uint64_t exact = coalesced_exact.load();
+        const std::uint64_t overlap = coalesced_overlap.load();
+        return "computed=" + std::to_string(queries_computed.load()) + " coalesced="
+            + std::to_string(exact + overlap) + " (exact=" + std::to_string(exact)
+            + " overlap=" + std::to_string(overlap) + ")";
+    }
+
+    // Registers the request as a waiter on a matching queued or running
+    // query and returns nullptr, or records it as a new one to compute.
+    std::shared_ptr<InFlightQuery> join_or_lead(std::uint64_t version, int source, std::uint64_t bound,
+        std::uint64_t id, std::chrono::steady_clock::time_point received) {
+        std::lock_guard<std::mutex> lock(flight_mutex);
+        for (const auto& flight : in_flight) {
+            if (flight->version != version || flight->source != source) {
+                continue;
+            }
+            if (flight->bound == bound) {
+                flight->waiters.push_back({ id, bound, received });
+                ++coalesced_exact;
+                return nullptr;
+            }
+            if (config.coalesce == CoalesceMode::overlap && flight->bound > bound) {
+                flight->waiters.push_back({ id, bound, received });
+                ++coalesced_overlap;
+                return nullptr;
+            }
+        }
+        auto flight = std::make_shared<InFlightQuery>();
+        flight->version = version;
+        flight->source = source;
+        flight->bound = bound;
+        in_flight.push_back(flight);
+        return flight;
+    }
+
+    // Retires an in-flight query; no request can join it afterwards.
+    std::vector<InFlightQuery::Waiter> finish(const std::shared_ptr<InFlightQuery>& flight) {
+        std::lock_guard<std::mutex> lock(flight_mutex);
+        in_flight.erase(std::find(in_flight.begin(), in_flight.end(), flight));
+        return std::move(flight->waiters);
+    }
+
+    // Retires a flight the leader still holds on any exit path, so a
+    // failed computation cannot leave it for later queries to join. Its
+    // waiters get the leader's error.
+    struct FlightGuard {
+        QueryServer& server;
+        WorkerMetrics& metrics;
+        std::shared_ptr<InFlightQuery> flight = nullptr;
+        std::string error = "query failed";
+
+        ~FlightGuard() {
+            if (!flight) {
+                return;
+            }
+            for (const auto& waiter : server.finish(flight)) {
+                try {
+                    server.output->line(std::to_string(waiter.id) + " error " + error);
+                }
+                catch (const std::exception&) {
+                }
+                record_request(metrics, 0, 2, waiter.received);
+            }
+        }
+    };
+
+    std::shared_ptr<const GraphSnapshot> make_snapshot(GraphLoadResult loaded) {
+        // An attached graph is read-only and keeps its published order.
+        if (config.sort_adjacency && !loaded.rows_sorted_by_weight && !loaded.graph.is_borrowed()) {
+            sort_adjacency_by_weight(loaded.graph);
+            loaded.rows_sorted_by_weight = true;
+        }
+        auto* snapshot = new GraphSnapshot();
+        snapshot->bytes = graph_bytes(loaded.graph);
+        snapshot->loaded = std::move(loaded);
+        snapshot->version = next_version++;
+        std::shared_ptr<ServerOutput> log = output;
+        return std::shared_ptr<const GraphSnapshot>(snapshot, [log](const GraphSnapshot* s) {
+            std::int64_t retired = s->retired_at_ns.load();
+            if (retired != 0) {
+                std::ostringstream oss;
+                oss << "* graph v" << s->version << " released " << std::fixed
+                    << std::setprecision(3)
+                    << static_cast<double>(steady_now_ns() - retired) / 1e6
+                    << " ms after swap, freeing " << s->bytes << " bytes";
+                log->line(oss.str());
+            }
+            delete s;
+        });
+    }
+
+    std::shared_ptr<const GraphSnapshot> snapshot() const { return std::atomic_load(&current); }
+
+    void submit(std::uint64_t id, const std::string& command, const std::string& line) {
+        const auto received = std::chrono::steady_clock::now();
+        // Shareable queries are registered as they arrive, so duplicates
+        // still queued behind a busy worker join them too. The flight pins
+        // the graph version it was registered under. Budgeted answers depend
+        // on each request's deadline and are never shared.
+        std::shared_ptr<InFlightQuery> flight;
+        std::shared_ptr<const GraphSnapshot> pinned;
+        if (command == "query" && config.coalesce != CoalesceMode::off
+            && !config.deadline_ms && config.work_budget == 0) {
+            pinned = snapshot();
+            if (auto key = shareable_query(line, pinned->loaded.graph.size())) {
+                flight = join_or_lead(pinned->version, key->first, key->second, id, received);
+                if (!flight) {
+                    return;
+                }
+            }
+            else {
+                // Malformed; the worker replies with the error.
+                pinned = nullptr;
+            }
         }
-        return 64 - static_cast<std::size_t>(__builtin_clzll(diff));
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            tasks.emplace_back([this, id, command, line, received, flight, pinned](std::size_t worker) mutable {
+                answer(worker, id, command, line, received, std::move(flight), std::move(pinned));
+            });
+        }
+        queue_ready.notify_one();
     }
 
-    void relocate() {
-        std::size_t i = 1;
-        while (i < buckets.size() && buckets[i].empty()) {
-            ++i;
+    // Source and bound of a well-formed "query" line, or nullopt.
+    static std::optional<std::pair<int, std::uint64_t>> shareable_query(const std::string& line, std::size_t n) {
+        std::istringstream iss(line);
+        std::string ignored;
+        long long source = -1;
+        iss >> ignored >> source;
+        if (!iss || (iss.peek() != EOF && !std::isspace(iss.peek())) || source < 0
+            || static_cast<std::size_t>(source) >= n) {
+            return std::nullopt;
         }
-        if (i == buckets.size()) {
-            throw std::logic_error("RadixHeap is empty");
+        try {
+            const auto bound = read_query_bound(iss).value_or(std::numeric_limits<std::uint64_t>::max());
+            return std::make_pair(static_cast<int>(source), bound);
+        }
+        catch (const std::exception&) {
+            return std::nullopt;
         }
+    }
 
-        auto new_last = buckets[i][0].first;
-        for (const auto& item : buckets[i]) {
-            if (item.first < new_last) {
-                new_last = item.first;
+    void worker_loop(std::size_t worker) {
+        for (;;) {
+            std::function<void(std::size_t)> task;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
             }
+            task(worker);
         }
-        last = new_last;
+    }
 
-        for (const auto& item : buckets[i]) {
-            std::size_t idx = bucket_index(item.first ^ last);
-            buckets[idx].push_back(item);
+    QueryBudget budget_from(std::chrono::steady_clock::time_point received) const {
+        QueryBudget budget;
+        if (config.deadline_ms) {
+            budget.deadline = received + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(*config.deadline_ms));
         }
-        buckets[i].clear();
+        budget.max_settled = config.work_budget;
+        return budget;
     }
-};
-
-std::vector<std::uint64_t> breaking_sorting_barrier_sssp(const Graph& graph, int source) {
-    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
-    std::vector<std::uint64_t> dist(graph.size(), INF);
-    dist[source] = 0;
 
-    RadixHeap pq;
-    pq.push(0, source);
+    // `flight` is the shared query this request leads, registered by
+    // submit together with the snapshot it runs on.
+    void answer(std::size_t worker, std::uint64_t id, const std::string& command, const std::string& line,
+        std::chrono::steady_clock::time_point received, std::shared_ptr<InFlightQuery> flight,
+        std::shared_ptr<const GraphSnapshot> pinned) {
+        const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+        const bool budgeted = config.deadline_ms || config.work_budget != 0;
+        WorkerMetrics& metrics = *worker_metrics[worker];
+        const std::size_t kind = command == "distance" ? 1 : 0;
+        // Lower bound on every unsettled vertex when the budget ran out.
+        std::optional<std::uint64_t> partial;
+        bool failed = false;
+        FlightGuard guard{ *this, metrics, std::move(flight) };
+        std::ostringstream oss;
+        oss << id << " ";
+        // Pin the snapshot until the answer has been written.
+        std::shared_ptr<const GraphSnapshot> snap = pinned ? std::move(pinned) : snapshot();
+        try {
+            const Graph& graph = snap->loaded.graph;
+            std::istringstream iss(line);
+            std::string ignored;
+            long long source = -1;
+            // Ids must be whole tokens: "1x" is not vertex 1.
+            auto whole_token = [&iss] { return iss.peek() == EOF || std::isspace(iss.peek()); };
+            iss >> ignored >> source;
+            if (!iss || !whole_token()) {
+                throw std::runtime_error("bad source");
+            }
+            if (source < 0 || static_cast<std::size_t>(source) >= graph.size()) {
+                throw std::runtime_error("source out of range");
+            }
 
-    while (!pq.empty()) {
-        auto [d, u] = pq.pop();
-        if (d != dist[u]) {
-            continue;
-        }
-        for (const auto& edge : graph[u]) {
-            std::uint64_t nd = d + edge.weight;
-            if (nd < dist[edge.to]) {
-                dist[edge.to] = nd;
-                pq.push(nd, edge.to);
+            auto start = std::chrono::steady_clock::now();
+            if (command == "distance") {
+                long long target = -1;
+                if (!(iss >> target) || !whole_token()) {
+                    throw std::runtime_error("bad target");
+                }
+                if (target < 0 || static_cast<std::size_t>(target) >= graph.size()) {
+                    throw std::runtime_error("target out of range");
+                }
+                std::string extra;
+                if (iss >> extra) {
+                    throw std::runtime_error("unexpected text after the target: " + extra);
+                }
+                PartialSssp answer;
+                if (budgeted) {
+                    answer = budgeted_sssp(graph, static_cast<int>(source), budget_from(received), INF,
+                        static_cast<int>(target), snap->loaded.rows_sorted_by_weight);
+                    count_engine(metrics, 2, answer.settled, answer.relaxations);
+                }
+                else {
+                    SsspCounters counters;
+                    answer.distances = bounded_sssp(graph, static_cast<int>(source), INF,
+                        static_cast<int>(target), snap->loaded.rows_sorted_by_weight, &counters);
+                    count_engine(metrics, 1, counters.pops - counters.stale_pops, counters.relaxations);
+                }
+                std::uint64_t d = answer.distances[static_cast<std::size_t>(target)];
+                oss << "ok distance " << source << " " << target << " = ";
+                if (d != INF) {
+                    oss << d;
+                }
+                else if (answer.complete) {
+                    oss << "unreachable";
+                }
+                else {
+                    oss << "unknown";
+                }
+                partial = answer.complete ? std::nullopt : std::optional<std::uint64_t>(answer.lower_bound);
+            }
+            else {
+                const std::uint64_t bound = read_query_bound(iss).value_or(INF);
+                PartialSssp answer;
+                if (budgeted) {
+                    answer = budgeted_sssp(graph, static_cast<int>(source), budget_from(received), bound, -1,
+                        snap->loaded.rows_sorted_by_weight);
+                    count_engine(metrics, 2, answer.settled, answer.relaxations);
+                }
+                else {
+                    SsspCounters counters;
+                    if (bound == INF) {
+                        answer.distances = lazy_sssp<RadixHeap>(graph, static_cast<int>(source), &counters);
+                    }
+                    else {
+                        answer.distances = bounded_sssp(graph, static_cast<int>(source), bound, -1,
+                            snap->loaded.rows_sorted_by_weight, &counters);
+                    }
+                    count_engine(metrics, bound == INF ? 0 : 1, counters.pops - counters.stale_pops,
+                        counters.relaxations);
+                }
+                ++queries_computed;
+                partial = answer.complete ? std::nullopt : std::optional<std::uint64_t>(answer.lower_bound);
+                oss << "ok query " << source << " " << query_summary(answer.distances, bound);
+                if (guard.flight) {
+                    const auto waiters = finish(std::exchange(guard.flight, nullptr));
+                    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                    for (const auto& waiter : waiters) {
+                        std::ostringstream line_out;
+                        line_out << waiter.id << " ok query " << source << " "
+                            << query_summary(answer.distances, waiter.bound) << " graph=v" << snap->version
+                            << " ms=" << std::fixed << std::setprecision(3) << elapsed.count()
+                            << " coalesced=" << id;
+                        output->line(line_out.str());
+                        record_request(metrics, 0, 0, waiter.received);
+                    }
+                }
+            }
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            oss << " graph=v" << snap->version << " ms=" << std::fixed << std::setprecision(3)
+                << elapsed.count();
+            if (partial) {
+                oss << " partial lower_bound=" << *partial;
             }
         }
+        catch (const std::exception& ex) {
+            oss << "error " << ex.what();
+            guard.error = ex.what();
+            failed = true;
+        }
+        output->line(oss.str());
+        record_request(metrics, kind, failed ? 2 : partial ? 1 : 0, received);
     }
 
-    return dist;
-}
+    void start_reload(std::uint64_t id, const std::string& spec) {
+        if (spec.empty()) {
+            output->line(std::to_string(id) + " error reload needs an input");
+            return;
+        }
+        if (reloading.exchange(true)) {
+            output->line(std::to_string(id) + " error a reload is already in progress");
+            return;
+        }
+        if (reloader.joinable()) {
+            reloader.join();
+        }
+        reloader = std::thread([this, id, spec] {
+            try {
+                auto load_start = std::chrono::steady_clock::now();
+                auto loaded = load_graph(spec, config.load);
+                if (loaded.graph.empty()) {
+                    throw std::runtime_error("graph is empty");
+                }
+                auto next = make_snapshot(std::move(loaded));
+                std::chrono::duration<double, std::milli> load_ms =
+                    std::chrono::steady_clock::now() - load_start;
+
+                std::int64_t swap_start = steady_now_ns();
+                std::shared_ptr<const GraphSnapshot> previous = std::atomic_exchange(&current, next);
+                std::int64_t swap_end = steady_now_ns();
+                previous->retired_at_ns.store(swap_end);
+
+                std::ostringstream oss;
+                oss << id << " ok reload v" << previous->version << " -> v" << next->version
+                    << " nodes=" << next->loaded.node_count << " load_ms=" << std::fixed
+                    << std::setprecision(3) << load_ms.count() << " swap_us="
+                    << static_cast<double>(swap_end - swap_start) / 1e3
+                    << " overlap_bytes=" << previous->bytes + next->bytes
+                    << " (old v" << previous->version << " held by "
+                    << previous.use_count() - 1 << " in-flight queries)";
+                output->line(oss.str());
+            }
+            catch (const std::exception& ex) {
+                output->line(std::to_string(id) + " error reload failed: " + ex.what());
+            }
+            reloading = false;
+        });
+    }
+};
 
 struct RunResult {
     std::vector<std::uint64_t> distances;
     std::chrono::duration<double, std::milli> elapsed_ms{};
 };
 
-RunResult time_algorithm(const Graph& graph, int source, const std::string& name,
-    std::vector<std::uint64_t>(*fn)(const Graph&, int),
-    int runs) {
+template <typename G, typename Fn>
+RunResult time_algorithm(const G& graph, int source, const std::string& name,
+    Fn fn, int runs) {
     std::vector<double> samples_ms;
     samples_ms.reserve(static_cast<std::size_t>(runs));
     std::vector<std::uint64_t> dist;
@@ -234,41 +6403,948 @@ void verify_results(const std::vector<std::uint64_t>& a,
     }
 }
 
+// Runs `engine_name` at 1, 2, 4, ... threads (plus the maximum) on the same
+// graph and source, best of `runs` each, and reports speedup, efficiency,
+// the Karp-Flatt serial fraction, per-thread work balance and achieved
+// bandwidth. Bandwidth that stops growing while threads double marks the
+// point where the memory system, not the algorithm, caps scaling.
+void run_scaling(const Graph& graph, int source, const std::string& engine_name, int max_threads,
+    int runs, const std::vector<std::uint64_t>& reference) {
+    std::vector<ParallelEngine> engines = parallel_engines();
+    auto engine = std::find_if(engines.begin(), engines.end(),
+        [&](const ParallelEngine& e) { return e.name == engine_name; });
+    if (engine == engines.end()) {
+        std::string names;
+        for (const auto& e : engines) {
+            names += (names.empty() ? "" : ", ") + e.name;
+        }
+        throw std::runtime_error("Unknown scaling engine '" + engine_name + "' (have: " + names + ")");
+    }
+    const CpuTopology topology = read_cpu_topology();
+    const int logical = static_cast<int>(topology.order.size());
+    if (max_threads <= 0) {
+        max_threads = logical;
+    }
+    std::vector<int> counts;
+    for (int p = 1; p < max_threads; p *= 2) {
+        counts.push_back(p);
+    }
+    counts.push_back(max_threads);
+
+    std::cout << "Strong scaling: " << engine->name << " (" << engine->description << "), best of "
+        << runs << " run(s)" << std::endl;
+    std::cout << "  " << logical << " logical CPU(s) on " << topology.cores << " core(s), "
+        << topology.sockets << " socket(s); threads fill cores socket by socket, then SMT siblings" << std::endl;
+    std::cout << "  threads   time ms  speedup  efficiency  karp-flatt  work/thread min..max (imbalance)    GB/s" << std::endl;
+
+    double base_ms = 0.0;
+    double previous_gbps = 0.0;
+    int previous_p = 0;
+    std::optional<int> saturated_at;
+    std::optional<int> efficiency_drop_at;
+    for (int p : counts) {
+        std::vector<int> cpus;
+        for (int t = 0; t < p; ++t) {
+            cpus.push_back(topology.order[static_cast<std::size_t>(t % logical)]);
+        }
+        double best_ms = std::numeric_limits<double>::infinity();
+        ParallelRun best;
+        for (int r = 0; r < runs; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            ParallelRun run = engine->run(graph, source, cpus);
+            const double ms = elapsed_ms(start);
+            if (ms < best_ms) {
+                best_ms = ms;
+                best = std::move(run);
+            }
+        }
+        verify_results(reference, best.distances);
+        if (p == 1) {
+            base_ms = best_ms;
+        }
+        const double speedup = base_ms / best_ms;
+        const double efficiency = speedup / p;
+        const auto [lo, hi] = std::minmax_element(best.thread_work.begin(), best.thread_work.end());
+        const double mean = std::accumulate(best.thread_work.begin(), best.thread_work.end(), 0.0)
+            / static_cast<double>(std::max<std::size_t>(1, best.thread_work.size()));
+        const double gbps = static_cast<double>(best.bytes_moved) / (best_ms * 1e6);
+
+        std::cout << "  " << std::setw(7) << std::right << p << std::fixed << std::setprecision(3)
+            << std::setw(10) << best_ms << std::setprecision(2) << std::setw(9) << speedup
+            << std::setw(12) << efficiency;
+        if (p > 1) {
+            // Karp-Flatt: e = (1/S - 1/p) / (1 - 1/p).
+            std::cout << std::setw(12) << std::setprecision(3) << (1.0 / speedup - 1.0 / p) / (1.0 - 1.0 / p);
+        }
+        else {
+            std::cout << std::setw(12) << "-";
+        }
+        std::ostringstream work;
+        work << *lo << ".." << *hi << " (" << std::fixed << std::setprecision(2)
+             << (mean > 0 ? static_cast<double>(*hi) / mean : 1.0) << "x)";
+        std::cout << "  " << std::setw(33) << work.str() << std::setprecision(2) << std::setw(8) << gbps;
+        if (p > logical) {
+            std::cout << "  oversubscribed";
+        }
+        else if (p > topology.cores) {
+            std::cout << "  uses SMT";
+        }
+        std::cout << std::left << std::endl;
+
+        if (previous_p > 0 && p <= logical) {
+            const double growth = gbps / previous_gbps;
+            const double ideal = static_cast<double>(p) / previous_p;
+            if (!saturated_at && growth < 1.0 + 0.15 * (ideal - 1.0) && efficiency < 0.8) {
+                saturated_at = p;
+            }
+        }
+        if (!efficiency_drop_at && p > 1 && efficiency < 0.5) {
+            efficiency_drop_at = p;
+        }
+        previous_gbps = gbps;
+        previous_p = p;
+    }
+    if (saturated_at) {
+        std::cout << "  bandwidth stops growing at " << *saturated_at
+            << " threads: likely memory-bandwidth saturation" << std::endl;
+    }
+    else if (efficiency_drop_at && *efficiency_drop_at > logical) {
+        std::cout << "  efficiency falls below 50% at " << *efficiency_drop_at << " threads, more than the "
+            << logical << " CPU(s) available: threads share CPUs there" << std::endl;
+    }
+    else if (efficiency_drop_at) {
+        std::cout << "  efficiency falls below 50% at " << *efficiency_drop_at
+            << " threads while bandwidth still grows: serial work or synchronisation (see Karp-Flatt)" << std::endl;
+    }
+    else if (counts.size() > 1) {
+        std::cout << "  scales to " << counts.back() << " threads without saturating" << std::endl;
+    }
+}
+
+struct Options {
+    std::string input_path;
+    int source = 0;
+    int runs = 1;
+    // Print the k closest vertices to the source (0 = off).
+    std::size_t nearest = 0;
+    // Sort each adjacency row by weight so bounded queries can prune rows.
+    bool sort_adjacency = false;
+    // Benchmark a bounded query (distances <= bound) when set.
+    std::optional<std::uint64_t> bound;
+    // Benchmark a point-to-point query to this vertex when set.
+    std::optional<int> target;
+    // Benchmark a one-to-many query to these vertices when non-empty.
+    std::vector<int> targets;
+    // Per-query deadline and settled-vertex budget; queries over budget
+    // return partial results (benchmark and serve mode).
+    std::optional<double> deadline_ms;
+    std::uint64_t work_budget = 0;
+    // Distance used for A* potentials when coordinates are loaded.
+    CoordinateMetric coords_metric = CoordinateMetric::euclidean;
+    // Run distributed delta-stepping with this many processes (0 = off).
+    int distributed = 0;
+    // Bucket width for delta-stepping; derived from the graph when unset.
+    std::optional<std::uint64_t> delta;
+    // Probe memory bandwidth and latency and place the engines against them.
+    bool roofline = false;
+    // Re-encode weights through a palette and benchmark it against the CSR.
+    bool palette = false;
+    // Time Dijkstra with rows above this degree relaxed in parallel
+    // (0 = derived from the average degree).
+    std::optional<std::size_t> hub_degree;
+    // Time the Crauser IN/OUT multi-settle engine.
+    bool crauser = false;
+    // Parallel engine to run the strong-scaling harness on, and the largest
+    // thread count (0 = every allowed CPU).
+    std::string scaling;
+    int scaling_threads = 0;
+    // Bounded queries in the scheduling batch (0 = off), and their bound.
+    std::size_t batch = 0;
+    std::optional<std::uint64_t> batch_bound;
+    // Publish the loaded graph as a shared segment (shm:/name or mmap:path).
+    std::string publish_graph;
+    // Answer queries from stdin instead of running the benchmark.
+    bool serve = false;
+    // In-flight query coalescing in serve mode.
+    CoalesceMode coalesce = CoalesceMode::off;
+    // Prometheus endpoint for serve mode (unix:<path> or tcp:[<host>:]<port>).
+    std::string metrics;
+    // Query worker threads in serve mode.
+    int workers = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    LoadOptions load;
+};
+
+// Parses a byte count with an optional K, M or G (binary) suffix.
+std::uint64_t parse_byte_size(const std::string& text) {
+    char* stop = nullptr;
+    const double value = std::strtod(text.c_str(), &stop);
+    const std::size_t used = static_cast<std::size_t>(stop - text.c_str());
+    if (used == 0) {
+        throw std::runtime_error("Sizes look like 512M or 4G: " + text);
+    }
+    std::string suffix = text.substr(used);
+    std::uint64_t scale = 1;
+    if (suffix == "K" || suffix == "k") {
+        scale = std::uint64_t{ 1 } << 10;
+    }
+    else if (suffix == "M" || suffix == "m") {
+        scale = std::uint64_t{ 1 } << 20;
+    }
+    else if (suffix == "G" || suffix == "g") {
+        scale = std::uint64_t{ 1 } << 30;
+    }
+    else if (!suffix.empty()) {
+        throw std::runtime_error("Sizes look like 512M or 4G: " + text);
+    }
+    if (!(value > 0)) {
+        throw std::runtime_error("Sizes must be positive: " + text);
+    }
+    return static_cast<std::uint64_t>(value * static_cast<double>(scale));
+}
+
+// Vertex list for --targets: comma-separated ids, or @path to a file with
+// ids separated by whitespace or commas.
+std::vector<int> parse_target_list(const std::string& value) {
+    std::string text = value;
+    if (!value.empty() && value[0] == '@') {
+        std::ifstream in(value.substr(1));
+        if (!in) {
+            throw std::runtime_error("Failed to open target list: " + value.substr(1));
+        }
+        text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::replace(text.begin(), text.end(), ',', ' ');
+    std::istringstream iss(text);
+    std::vector<int> targets;
+    for (long long id; iss >> id;) {
+        // Checked before narrowing, so 2^32 + 5 is not taken for vertex 5.
+        if (id < 0 || id > std::numeric_limits<int>::max()) {
+            throw std::runtime_error("Target id out of range: " + std::to_string(id));
+        }
+        targets.push_back(static_cast<int>(id));
+    }
+    if (!iss.eof() || targets.empty()) {
+        throw std::runtime_error("--targets needs a list of vertex ids");
+    }
+    return targets;
+}
+
+// Positional arguments are <input_file> <source_node> [runs]; everything that
+// starts with "--" is an option of the form --name or --name=value.
+Options parse_options(int argc, char** argv) {
+    Options opts;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            positional.push_back(arg);
+            continue;
+        }
+        std::string name = arg.substr(2);
+        std::string value;
+        auto eq = name.find('=');
+        if (eq != std::string::npos) {
+            value = name.substr(eq + 1);
+            name = name.substr(0, eq);
+        }
+        if (name == "nearest") {
+            opts.nearest = parse_number<std::size_t>("--nearest", value);
+        }
+        else if (name == "sort-adjacency") {
+            opts.sort_adjacency = true;
+            opts.load.sort_rows = true;
+        }
+        else if (name == "bound") {
+            opts.bound = parse_number<std::uint64_t>("--bound", value);
+        }
+        else if (name == "target") {
+            opts.target = parse_number<int>("--target", value);
+        }
+        else if (name == "targets") {
+            opts.targets = parse_target_list(value);
+        }
+        else if (name == "deadline") {
+            opts.deadline_ms = parse_number<double>("--deadline", value);
+            if (*opts.deadline_ms <= 0.0) {
+                throw std::runtime_error("--deadline must be positive");
+            }
+        }
+        else if (name == "work-budget") {
+            opts.work_budget = parse_number<std::uint64_t>("--work-budget", value);
+            if (opts.work_budget == 0) {
+                throw std::runtime_error("--work-budget must be positive");
+            }
+        }
+        else if (name == "mem-limit") {
+            opts.load.mem_limit = parse_byte_size(value);
+        }
+        else if (name == "coords") {
+            opts.load.coords_path = value;
+        }
+        else if (name == "coords-metric") {
+            if (value == "euclid") {
+                opts.coords_metric = CoordinateMetric::euclidean;
+            }
+            else if (value == "geo") {
+                opts.coords_metric = CoordinateMetric::great_circle;
+            }
+            else {
+                throw std::runtime_error("--coords-metric must be euclid or geo");
+            }
+        }
+        else if (name == "distributed") {
+            opts.distributed = parse_number<int>("--distributed", value);
+            if (opts.distributed < 1) {
+                throw std::runtime_error("--distributed needs at least one process");
+            }
+        }
+        else if (name == "roofline") {
+            opts.roofline = true;
+        }
+        else if (name == "palette") {
+            opts.palette = true;
+        }
+        else if (name == "crauser") {
+            opts.crauser = true;
+        }
+        else if (name == "hub-degree") {
+            opts.hub_degree = value.empty() ? 0 : parse_number<std::size_t>("--hub-degree", value);
+        }
+        else if (name == "scaling") {
+            const auto colon = value.find(':');
+            opts.scaling = value.substr(0, colon);
+            if (colon != std::string::npos) {
+                opts.scaling_threads = std::max(1, parse_number<int>("--scaling thread count", value.substr(colon + 1)));
+            }
+        }
+        else if (name == "batch") {
+            const auto colon = value.find(':');
+            opts.batch = parse_number<std::size_t>("--batch", value.substr(0, colon));
+            if (opts.batch == 0) {
+                throw std::runtime_error("--batch needs at least one query");
+            }
+            if (colon != std::string::npos) {
+                opts.batch_bound = parse_number<std::uint64_t>("--batch bound", value.substr(colon + 1));
+            }
+        }
+        else if (name == "serve") {
+            opts.serve = true;
+        }
+        else if (name == "metrics") {
+            if (value.empty()) {
+                throw std::runtime_error("--metrics needs unix:<path> or tcp:[<host>:]<port>");
+            }
+            opts.metrics = value;
+        }
+        else if (name == "coalesce") {
+            if (value.empty() || value == "exact") {
+                opts.coalesce = CoalesceMode::exact;
+            }
+            else if (value == "overlap") {
+                opts.coalesce = CoalesceMode::overlap;
+            }
+            else if (value == "off") {
+                opts.coalesce = CoalesceMode::off;
+            }
+            else {
+                throw std::runtime_error("--coalesce must be exact, overlap or off");
+            }
+        }
+        else if (name == "workers") {
+            opts.workers = std::max(1, parse_number<int>("--workers", value));
+        }
+        else if (name == "io") {
+            opts.load.io_backend = value;
+        }
+        else if (name == "format") {
+            opts.load.format = value;
+        }
+        else if (name == "weight-scale") {
+            opts.load.weight_scale = parse_number<double>("--weight-scale", value);
+            if (!(opts.load.weight_scale > 0)) {
+                throw std::runtime_error("--weight-scale must be positive");
+            }
+        }
+        else if (name == "parser-threads") {
+            opts.load.parser_threads = std::max(1, parse_number<int>("--parser-threads", value));
+        }
+        else if (name == "publish-graph") {
+            opts.publish_graph = value;
+        }
+        else if (name == "delta") {
+            opts.delta = std::max<std::uint64_t>(1, parse_number<std::uint64_t>("--delta", value));
+        }
+        else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    // These modes need a CSR Graph, so a memory budget may only fall back
+    // to the out-of-core CSR.
+    if (opts.serve || opts.distributed > 0 || !opts.publish_graph.empty()) {
+        opts.load.compact_representations = false;
+    }
+    // Serve mode takes its sources from the query stream.
+    const std::size_t required = opts.serve ? 1 : 2;
+    if (positional.size() < required || positional.size() > 3) {
+        throw std::runtime_error("Expected <input_file> <source_node> [runs]");
+    }
+    opts.input_path = positional[0];
+    if (positional.size() >= 2) {
+        opts.source = parse_number<int>("<source_node>", positional[1]);
+    }
+    if (positional.size() == 3) {
+        opts.runs = std::max(1, parse_number<int>("[runs]", positional[2]));
+    }
+    return opts;
+}
+
+// Times bounded and point-to-point queries, checks them against the full
+// distance vector and reports how many edges row pruning skipped.
+void run_bounded_queries(const Graph& graph, int source, const Options& opts,
+    bool rows_sorted, const std::vector<std::uint64_t>& reference) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    auto report = [](const SsspCounters& stats) {
+        std::cout << "  relaxed " << stats.relaxations << " edges, skipped "
+            << stats.pruned_edges << " edges by row pruning" << std::endl;
+    };
+
+    if (opts.bound) {
+        const std::uint64_t bound = *opts.bound;
+        SsspCounters stats;
+        RunResult result = time_algorithm(graph, source,
+            "Bounded query (d <= " + std::to_string(bound) + ")",
+            [&](const Graph& g, int s) {
+                return bounded_sssp(g, s, bound, -1, rows_sorted, &stats);
+            },
+            opts.runs);
+        std::vector<std::uint64_t> expected = reference;
+        for (auto& d : expected) {
+            if (d > bound) {
+                d = INF;
+            }
+        }
+        verify_results(expected, result.distances);
+        report(stats);
+    }
+
+    if (opts.target) {
+        const int target = *opts.target;
+        if (target < 0 || static_cast<std::size_t>(target) >= graph.size()) {
+            throw std::runtime_error("Target node is out of range for the graph");
+        }
+        SsspCounters stats;
+        RunResult result = time_algorithm(graph, source,
+            "Point-to-point query (-> " + std::to_string(target) + ")",
+            [&](const Graph& g, int s) {
+                return bounded_sssp(g, s, opts.bound.value_or(INF), target, rows_sorted, &stats);
+            },
+            opts.runs);
+        std::uint64_t expected = reference[static_cast<std::size_t>(target)];
+        if (opts.bound && expected > *opts.bound) {
+            expected = INF;
+        }
+        if (result.distances[static_cast<std::size_t>(target)] != expected) {
+            throw std::runtime_error("Point-to-point distance does not match full SSSP");
+        }
+        std::cout << "  settled " << stats.pops - stats.stale_pops << " vertices" << std::endl;
+        std::cout << "  distance " << source << " -> " << target << " = ";
+        if (expected == INF) {
+            std::cout << "unreachable";
+        }
+        else {
+            std::cout << expected;
+        }
+        std::cout << std::endl;
+        report(stats);
+    }
+}
+
+// Times a one-to-many query to the --targets list (honouring --bound) and
+// checks it against the full distance vector.
+void run_one_to_many_query(const Graph& graph, int source, const Options& opts, bool rows_sorted,
+    const std::vector<std::uint64_t>& reference) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    const std::uint64_t bound = opts.bound.value_or(INF);
+    SsspCounters stats;
+    RunResult result = time_algorithm(graph, source,
+        "One-to-many query (" + std::to_string(opts.targets.size()) + " targets)",
+        [&](const Graph& g, int s) { return one_to_many(g, s, opts.targets, bound, rows_sorted, &stats); },
+        opts.runs);
+    std::size_t reached = 0;
+    for (std::size_t i = 0; i < opts.targets.size(); ++i) {
+        std::uint64_t expected = reference[static_cast<std::size_t>(opts.targets[i])];
+        if (expected > bound) {
+            expected = INF;
+        }
+        if (result.distances[i] != expected) {
+            throw std::runtime_error("One-to-many distance to " + std::to_string(opts.targets[i])
+                + " does not match full SSSP");
+        }
+        reached += expected == INF ? 0 : 1;
+    }
+    std::cout << "  " << reached << " of " << opts.targets.size() << " targets reached, settled "
+        << stats.pops - stats.stale_pops << " of " << graph.size() << " vertices" << std::endl;
+}
+
+// Runs one budgeted query under --deadline/--work-budget (and --bound) and
+// checks that what it returns is sound: settled distances are exact and
+// the lower bound holds for every vertex it left unsettled.
+void run_budgeted_query(const Graph& graph, int source, const Options& opts, bool rows_sorted,
+    const std::vector<std::uint64_t>& reference) {
+    const std::uint64_t INF = std::numeric_limits<std::uint64_t>::max();
+    const std::uint64_t bound = opts.bound.value_or(INF);
+    QueryBudget budget;
+    budget.max_settled = opts.work_budget;
+    auto start = std::chrono::steady_clock::now();
+    if (opts.deadline_ms) {
+        budget.deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::milli>(*opts.deadline_ms));
+    }
+    PartialSssp result = budgeted_sssp(graph, source, budget, bound, -1, rows_sorted);
+    const double ms = elapsed_ms(start);
+
+    for (std::size_t v = 0; v < graph.size(); ++v) {
+        const std::uint64_t expected = reference[v] > bound ? INF : reference[v];
+        if (result.distances[v] != INF) {
+            if (result.distances[v] != expected) {
+                throw std::runtime_error("Budgeted query settled vertex " + std::to_string(v) + " at a wrong distance");
+            }
+        }
+        else if (!result.complete && expected < result.lower_bound) {
+            throw std::runtime_error("Budgeted query lower bound exceeds the distance of vertex " + std::to_string(v));
+        }
+        else if (result.complete && expected != INF) {
+            throw std::runtime_error("Budgeted query completed without settling vertex " + std::to_string(v));
+        }
+    }
+    std::cout << std::setw(30) << std::left << "Budgeted query" << ": " << std::fixed << std::setprecision(3)
+        << ms << " ms, " << (result.complete ? "complete" : "partial") << ", settled " << result.settled
+        << " of " << graph.size() << " vertices";
+    if (!result.complete) {
+        std::cout << ", every other vertex >= " << result.lower_bound;
+    }
+    std::cout << std::endl;
+}
+
+void print_load_report(const LoadReport& report) {
+    if (report.io_backend.empty()) {
+        return;
+    }
+    const double mib = static_cast<double>(report.bytes) / (1024.0 * 1024.0);
+    std::cout << "Read " << std::fixed << std::setprecision(1) << mib << " MiB " << report.format;
+    if (report.decoded_bytes != report.bytes) {
+        std::cout << " (" << static_cast<double>(report.decoded_bytes) / (1024.0 * 1024.0)
+            << " MiB decompressed)";
+    }
+    std::cout << " via "
+        << report.io_backend << " with " << report.parser_threads << " parser thread(s) in "
+        << std::setprecision(3) << report.total_ms << " ms ("
+        << std::setprecision(1) << (report.total_ms > 0 ? mib / (report.total_ms / 1000.0) : 0.0)
+        << " MiB/s, " << std::setprecision(3) << report.io_wait_ms << " ms waiting on input)"
+        << std::endl;
+}
+
+double to_mib(std::uint64_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+void print_memory_plan(const MemoryPlan& plan) {
+    std::cout << "Memory limit " << std::fixed << std::setprecision(1) << to_mib(plan.limit)
+        << " MiB: " << to_mib(plan.base_bytes) << " MiB resident after parsing ("
+        << to_mib(plan.parsed_bytes) << " MiB parsed edges, " << to_mib(plan.parse_peak_bytes)
+        << " MiB peak), ~" << to_mib(plan.working_bytes)
+        << " MiB engine working memory" << std::endl;
+    for (const auto& e : plan.estimates) {
+        std::cout << "  " << std::setw(18) << std::left << representation_name(e.kind) << " graph "
+            << std::setw(9) << std::right << to_mib(e.graph_bytes) << " MiB, peak " << std::setw(9)
+            << to_mib(e.peak_bytes) << " MiB" << std::left;
+        if (e.kind == plan.chosen) {
+            std::cout << "  <- chosen";
+        }
+        else if (!e.applicable) {
+            std::cout << "  (not used)";
+        }
+        else if (e.peak_bytes > plan.limit) {
+            std::cout << "  (over limit)";
+        }
+        std::cout << std::endl;
+    }
+    if (plan.projected_peak > plan.limit) {
+        std::cout << "  nothing fits; falling back to the smallest layout" << std::endl;
+    }
+}
+
+void print_peak_memory(const MemoryPlan& plan) {
+    std::cout << "Peak memory (" << representation_name(plan.chosen) << ", graph "
+        << std::fixed << std::setprecision(1) << to_mib(plan.actual_graph_bytes) << " MiB): projected "
+        << to_mib(plan.projected_peak) << " MiB, actual " << to_mib(peak_rss_bytes()) << " MiB";
+    // Mapped file pages count towards RSS but the kernel can drop them.
+    if (plan.chosen == Representation::out_of_core) {
+        std::cout << " (including reclaimable file pages)";
+    }
+    std::cout << std::endl;
+}
+
+// Benchmarks the engines templated on the graph layout on a narrow or
+// compressed graph; the other engines and queries need a CSR Graph.
+template <typename G>
+void run_layout_benchmark(const G& graph, const std::string& layout, int source, int runs) {
+    RunResult heap_result = time_algorithm(graph, source, "Dijkstra (" + layout + ")",
+        [](const G& g, int s) { return lazy_sssp<BinaryHeap>(g, s); }, runs);
+    RunResult radix_result = time_algorithm(graph, source, "Radix SSSP (" + layout + ")",
+        [](const G& g, int s) { return lazy_sssp<RadixHeap>(g, s); }, runs);
+    verify_results(heap_result.distances, radix_result.distances);
+    std::cout << "Results match for all algorithms." << std::endl;
+    std::cout << "Other engines and queries need a CSR graph; skipped under this memory limit." << std::endl;
+}
+
+// Options the benchmark honours only on a CSR Graph, as given on the command
+// line, so a compact layout can say which ones it ignored.
+std::vector<std::string> csr_only_options(const Options& opts) {
+    std::vector<std::string> names;
+    auto note = [&](bool set, const char* name) {
+        if (set) {
+            names.push_back(name);
+        }
+    };
+    note(opts.sort_adjacency, "--sort-adjacency");
+    note(opts.bound.has_value(), "--bound");
+    note(opts.target.has_value(), "--target");
+    note(!opts.targets.empty(), "--targets");
+    note(!opts.load.coords_path.empty(), "--coords");
+    note(opts.deadline_ms.has_value(), "--deadline");
+    note(opts.work_budget != 0, "--work-budget");
+    note(opts.distributed > 0, "--distributed");
+    note(opts.roofline, "--roofline");
+    note(opts.palette, "--palette");
+    note(opts.hub_degree.has_value(), "--hub-degree");
+    note(opts.crauser, "--crauser");
+    note(!opts.scaling.empty(), "--scaling");
+    note(opts.batch > 0, "--batch");
+    note(!opts.publish_graph.empty(), "--publish-graph");
+    note(opts.nearest > 0, "--nearest");
+    return names;
+}
+
+// Times hub_parallel_sssp on every allowed CPU and shows how much of the
+// work the hub rows were.
+void run_hub_benchmark(const Graph& graph, int source, std::size_t hub_degree, int runs,
+    const std::vector<std::uint64_t>& reference) {
+    if (hub_degree == 0) {
+        hub_degree = default_hub_degree(graph);
+    }
+    const std::vector<int> cpus = read_cpu_topology().order;
+    HubStats stats;
+    RunResult result = time_algorithm(graph, source, "Dijkstra (parallel hubs)",
+        [&](const Graph& g, int s) { return hub_parallel_sssp(g, s, hub_degree, cpus, &stats); }, runs);
+    verify_results(reference, result.distances);
+
+    std::size_t hubs = 0;
+    for (std::size_t u = 0; u < graph.size(); ++u) {
+        hubs += graph[u].size() > hub_degree ? 1 : 0;
+    }
+    const std::uint64_t edges = std::accumulate(stats.thread_edges.begin(), stats.thread_edges.end(),
+        std::uint64_t{ 0 });
+    std::cout << std::setw(30) << std::left << "Hub rows" << ": degree > " << hub_degree << ", " << hubs
+        << " hub vertices, " << stats.hub_pops << " of " << stats.pops << " pops, " << stats.hub_edges
+        << " of " << edges << " edges relaxed on " << cpus.size() << " thread(s), " << stats.merged
+        << " improvements merged" << std::endl;
+}
+
+// Times crauser_sssp on every allowed CPU, with the per-vertex bounds
+// computed once up front as a load-time step, and reports how many
+// vertices each phase settled.
+void run_crauser_benchmark(const Graph& graph, int source, int runs,
+    const std::vector<std::uint64_t>& reference) {
+    auto start = std::chrono::steady_clock::now();
+    const CrauserBounds bounds = crauser_bounds(graph);
+    const double bounds_ms = elapsed_ms(start);
+    const std::vector<int> cpus = read_cpu_topology().order;
+    CrauserStats stats;
+    RunResult result = time_algorithm(graph, source, "Crauser IN/OUT (parallel)",
+        [&](const Graph& g, int s) { return crauser_sssp(g, s, bounds, cpus, &stats); }, runs);
+    verify_results(reference, result.distances);
+    std::cout << std::setw(30) << std::left << "Crauser phases" << ": " << stats.phases << " phases for "
+        << stats.settled << " vertices (" << std::fixed << std::setprecision(1)
+        << (stats.phases == 0 ? 0.0 : static_cast<double>(stats.settled) / static_cast<double>(stats.phases))
+        << " per phase, largest " << stats.largest_phase << "), " << stats.settled_by_in_only
+        << " settled by IN only, on " << cpus.size() << " thread(s); bounds took "
+        << std::setprecision(3) << bounds_ms << " ms" << std::endl;
+}
+
+// Re-encodes the CSR with a weight palette when it has at most 65536
+// distinct weights, then times the two lazy engines on it against the CSR
+// timings already taken and reports the bytes saved.
+void run_palette_benchmark(const Graph& graph, int source, int runs,
+    const RunResult& csr_dijkstra, const RunResult& csr_radix) {
+    auto start = std::chrono::steady_clock::now();
+    auto palette = weight_alphabet(graph, PaletteGraph<std::uint16_t>::kMaxWeights);
+    if (!palette) {
+        std::cout << "Weight palette: more than " << PaletteGraph<std::uint16_t>::kMaxWeights
+            << " distinct weights; skipped." << std::endl;
+        return;
+    }
+    const std::size_t distinct = palette->size();
+    const std::size_t csr_bytes = graph_bytes(graph);
+
+    auto bench = [&](const auto& encoded, const std::string& layout) {
+        const double encode_ms = elapsed_ms(start);
+        const std::size_t bytes = encoded.bytes();
+        std::cout << "Weight palette: " << distinct << " distinct weights, " << layout << " indices, "
+            << std::fixed << std::setprecision(1) << to_mib(bytes) << " MiB vs " << to_mib(csr_bytes)
+            << " MiB CSR (" << to_mib(csr_bytes - std::min(bytes, csr_bytes)) << " MiB, "
+            << 100.0 * (1.0 - static_cast<double>(bytes) / static_cast<double>(csr_bytes))
+            << "% saved), encoded in " << std::setprecision(3) << encode_ms << " ms" << std::endl;
+        using G = std::decay_t<decltype(encoded)>;
+        RunResult heap_result = time_algorithm(encoded, source, "Dijkstra (palette)",
+            [](const G& g, int s) { return lazy_sssp<BinaryHeap>(g, s); }, runs);
+        RunResult radix_result = time_algorithm(encoded, source, "Radix SSSP (palette)",
+            [](const G& g, int s) { return lazy_sssp<RadixHeap>(g, s); }, runs);
+        verify_results(csr_dijkstra.distances, heap_result.distances);
+        verify_results(csr_dijkstra.distances, radix_result.distances);
+        std::cout << "Palette speed vs CSR: Dijkstra " << std::setprecision(2)
+            << csr_dijkstra.elapsed_ms.count() / heap_result.elapsed_ms.count() << "x, radix "
+            << csr_radix.elapsed_ms.count() / radix_result.elapsed_ms.count() << "x" << std::endl;
+    };
+    if (distinct <= PaletteGraph<std::uint8_t>::kMaxWeights) {
+        bench(PaletteGraph<std::uint8_t>::encode(graph, std::move(*palette)), "8-bit");
+    }
+    else {
+        bench(PaletteGraph<std::uint16_t>::encode(graph, std::move(*palette)), "16-bit");
+    }
+}
+
+void print_nearest(const Graph& graph, int source, std::size_t k) {
+    SettleOrderIterator it(graph, source);
+    std::cout << "Nearest " << k << " vertices to " << source << ":";
+    while (it.settled() < k) {
+        auto next = it.next();
+        if (!next) {
+            break;
+        }
+        std::cout << " " << next->vertex << "(" << next->distance << ")";
+    }
+    std::cout << std::endl;
+}
+
+// Times A* to --target with geometric potentials and checks its distance
+// against full SSSP.
+void run_astar_query(const Graph& graph, const std::vector<Coordinate>& coords, int source,
+    const Options& opts, const std::vector<std::uint64_t>& reference) {
+    const int target = *opts.target;
+    GeometricPotential potential(graph, coords, opts.coords_metric);
+    SsspCounters stats;
+    RunResult result = time_algorithm(graph, source, "A* query (-> " + std::to_string(target) + ")",
+        [&](const Graph& g, int s) { return astar_sssp(g, s, target, potential, &stats); },
+        opts.runs);
+    if (result.distances[static_cast<std::size_t>(target)] != reference[static_cast<std::size_t>(target)]) {
+        throw std::runtime_error("A* distance does not match full SSSP");
+    }
+    std::cout << "  settled " << stats.pops - stats.stale_pops << " vertices, relaxed "
+        << stats.relaxations << " edges (" << std::setprecision(6) << potential.weight_per_length()
+        << " weight per unit length)" << std::endl;
+}
+
 void print_help(const std::string& exe) {
-    std::cout << "Usage: " << exe << " <input_file> <source_node> [runs]" << std::endl;
-    std::cout << "\nInput file format: each line has 'from to weight' (space or tab separated)." << std::endl;
+    std::cout << "Usage: " << exe << " <input_file> <source_node> [runs] [options]" << std::endl;
+    std::cout << "\n<input_file> may also be shm:/name or mmap:path to attach a published graph read-only." << std::endl;
+    std::cout << "Input file format: each line has 'from to weight' (space or tab separated)." << std::endl;
     std::cout << "Nodes are zero-indexed. Lines starting with # are ignored." << std::endl;
+    std::cout << "DIMACS (.gr), SNAP, MatrixMarket (.mtx) and METIS (.graph) files are read natively." << std::endl;
     std::cout << "Optional 'runs' allows repeating each algorithm to smooth timings (default: 1)." << std::endl;
+    std::cout << "\nOptions:" << std::endl;
+    std::cout << "  --nearest=K        print the K vertices closest to the source, in settle order" << std::endl;
+    std::cout << "  --sort-adjacency   sort adjacency rows by weight so bounded queries can prune them" << std::endl;
+    std::cout << "  --bound=B          also benchmark a query that only settles distances <= B" << std::endl;
+    std::cout << "  --target=T         also benchmark a point-to-point query to T (combines with --bound)" << std::endl;
+    std::cout << "  --targets=LIST     also benchmark a one-to-many query to ids a,b,c or @file (combines with --bound)" << std::endl;
+    std::cout << "  --deadline=MS      per-query deadline; over-budget queries return settled part + lower bound" << std::endl;
+    std::cout << "  --work-budget=N    per-query limit on settled vertices, with the same partial answers" << std::endl;
+    std::cout << "  --coords=FILE      load vertex coordinates (DIMACS .co or 'id x y') and run A* to --target" << std::endl;
+    std::cout << "  --coords-metric=M  A* distance: euclid (default) or geo (great-circle, microdegrees)" << std::endl;
+    std::cout << "  --distributed=P    also run delta-stepping partitioned across P processes" << std::endl;
+    std::cout << "  --delta=D          bucket width for delta-stepping (default: max weight / avg degree)" << std::endl;
+    std::cout << "  --crauser          also time the Crauser IN/OUT multi-settle engine on all CPUs" << std::endl;
+    std::cout << "  --hub-degree[=D]   also time Dijkstra relaxing rows with more than D edges on all CPUs" << std::endl;
+    std::cout << "  --palette          store weights as 8/16-bit palette indices and compare with the CSR" << std::endl;
+    std::cout << "  --roofline         measure memory bandwidth and latency and classify each engine against them" << std::endl;
+    std::cout << "  --scaling=E[:P]    strong-scaling report for parallel engine E (delta-threads, hub-threads, crauser, multi-source) up to P threads" << std::endl;
+    std::cout << "  --batch=K[:B]      run K bounded queries (bound B) in FIFO and locality-aware order" << std::endl;
+    std::cout << "  --publish-graph=S  publish the loaded graph to shm:/name or mmap:path for other processes" << std::endl;
+    std::cout << "  --io=B             input reader: auto (io_uring if available), uring or pread" << std::endl;
+    std::cout << "  --format=F         input format: auto, edge, dimacs, snap, mtx or metis (default: auto)" << std::endl;
+    std::cout << "  --weight-scale=X   multiply MatrixMarket real values by X before rounding (default: 1)" << std::endl;
+    std::cout << "  --mem-limit=S      memory budget (e.g. 2G); picks the fastest graph layout that fits" << std::endl;
+    std::cout << "  --parser-threads=N threads parsing the input (default: hardware threads)" << std::endl;
+    std::cout << "  --serve            answer queries read from stdin (source node optional); see README" << std::endl;
+    std::cout << "  --coalesce[=M]     --serve: share in-flight queries, exact (same source and bound) or overlap" << std::endl;
+    std::cout << "  --metrics=S        --serve: Prometheus metrics on unix:<path> or tcp:[<host>:]<port>" << std::endl;
+    std::cout << "  --workers=N        query worker threads for --serve (default: hardware threads)" << std::endl;
 }
 
 int main(int argc, char** argv) {
-    if (argc < 3) {
+    if (argc < 2) {
         print_help(argv[0]);
         return 1;
     }
 
-    const std::string input_path = argv[1];
-    const int source = std::stoi(argv[2]);
-    const int runs = (argc >= 4) ? std::max(1, std::stoi(argv[3])) : 1;
-
     try {
-        auto loaded = read_graph_from_file(input_path);
-        if (loaded.graph.empty()) {
+        const Options opts = parse_options(argc, argv);
+        const std::string& input_path = opts.input_path;
+        const int source = opts.source;
+        const int runs = opts.runs;
+
+        auto loaded = load_graph(input_path, opts.load);
+        if (loaded.node_count == 0) {
             throw std::runtime_error("Input graph is empty; provide at least one edge.");
         }
+        if (opts.serve) {
+            ServerConfig config;
+            config.workers = opts.workers;
+            config.sort_adjacency = opts.sort_adjacency;
+            config.load = opts.load;
+            config.deadline_ms = opts.deadline_ms;
+            config.work_budget = opts.work_budget;
+            config.coalesce = opts.coalesce;
+            config.metrics = opts.metrics;
+            std::cout << "Serving graph with " << loaded.node_count << " nodes on "
+                << config.workers << " worker(s)." << std::endl;
+            QueryServer server(std::move(loaded), config, std::cout);
+            server.run(std::cin);
+            return 0;
+        }
         if (source < 0 || source >= loaded.node_count) {
             throw std::runtime_error("Source node is out of range for the graph");
         }
 
-        std::cout << "Loaded graph with " << loaded.node_count << " nodes." << std::endl;
+        std::cout << "Loaded graph with " << loaded.node_count << " nodes";
+        if (loaded.graph.is_borrowed()) {
+            std::cout << " (attached read-only)";
+        }
+        std::cout << "." << std::endl;
+        print_load_report(loaded.report);
+        if (loaded.memory_plan) {
+            print_memory_plan(*loaded.memory_plan);
+        }
+        if (loaded.representation == Representation::narrow_csr
+            || loaded.representation == Representation::compressed) {
+            if (loaded.representation == Representation::narrow_csr) {
+                run_layout_benchmark(loaded.narrow, "narrow CSR", source, runs);
+            }
+            else {
+                run_layout_benchmark(loaded.compressed, "compressed", source, runs);
+            }
+            const std::vector<std::string> ignored = csr_only_options(opts);
+            if (!ignored.empty()) {
+                std::cout << "Ignored with the " << representation_name(loaded.representation) << " layout:";
+                for (const auto& name : ignored) {
+                    std::cout << " " << name;
+                }
+                std::cout << std::endl;
+            }
+            print_peak_memory(*loaded.memory_plan);
+            return 0;
+        }
+        if (!loaded.coordinates.empty()) {
+            std::cout << "Loaded " << loaded.coordinates.size() << " vertex coordinates." << std::endl;
+        }
+        if (opts.sort_adjacency && !loaded.rows_sorted_by_weight && loaded.graph.is_borrowed()) {
+            std::cout << "--sort-adjacency skipped: the attached graph is read-only and was published unsorted."
+                << std::endl;
+        }
+        else if (opts.sort_adjacency && !loaded.rows_sorted_by_weight) {
+            sort_adjacency_by_weight(loaded.graph);
+            loaded.rows_sorted_by_weight = true;
+            std::cout << "Adjacency rows sorted by weight." << std::endl;
+        }
+        if (!opts.publish_graph.empty()) {
+            std::size_t bytes = publish_graph(loaded.graph, loaded.rows_sorted_by_weight,
+                opts.publish_graph);
+            std::cout << "Published graph to " << opts.publish_graph << " (" << bytes
+                << " bytes)." << std::endl;
+        }
         RunResult dijkstra_result =
             time_algorithm(loaded.graph, source, "Dijkstra (binary heap)", dijkstra, runs);
         RunResult breaking_result = time_algorithm(loaded.graph, source,
             "Breaking Sorting Barrier SSSP",
             breaking_sorting_barrier_sssp, runs);
 
+        RunResult aligned_result = time_algorithm(loaded.graph, source,
+            "Dijkstra (8-ary aligned heap)", dijkstra_aligned_heap, runs);
+        RunResult iterator_result = time_algorithm(loaded.graph, source,
+            "Settle-order iterator (radix)", settle_order_sssp, runs);
+        RunResult decrease_key_result = time_algorithm(loaded.graph, source,
+            "Radix heap (decrease-key)",
+            [](const Graph& g, int s) { return radix_decrease_key_sssp(g, s); }, runs);
+        RunResult veb_result = time_algorithm(loaded.graph, source,
+            "vEB integer queue", veb_sssp, runs);
+
         verify_results(dijkstra_result.distances, breaking_result.distances);
-        std::cout << "Results match for both algorithms." << std::endl;
+        verify_results(dijkstra_result.distances, aligned_result.distances);
+        verify_results(dijkstra_result.distances, iterator_result.distances);
+        verify_results(dijkstra_result.distances, decrease_key_result.distances);
+        verify_results(dijkstra_result.distances, veb_result.distances);
+        std::cout << "Results match for all algorithms." << std::endl;
+        if (opts.palette) {
+            run_palette_benchmark(loaded.graph, source, runs, dijkstra_result, breaking_result);
+        }
+        if (opts.hub_degree) {
+            run_hub_benchmark(loaded.graph, source, *opts.hub_degree, runs, dijkstra_result.distances);
+        }
+        if (opts.crauser) {
+            run_crauser_benchmark(loaded.graph, source, runs, dijkstra_result.distances);
+        }
+
+        report_heap_entries(loaded.graph, source);
+        report_integer_queues(loaded.graph, source);
+
+        report_heap_cache_misses(loaded.graph, source);
+        if (opts.roofline) {
+            report_roofline(loaded.graph, source);
+        }
+
+        run_bounded_queries(loaded.graph, source, opts, loaded.rows_sorted_by_weight,
+            dijkstra_result.distances);
+        if (opts.deadline_ms || opts.work_budget != 0) {
+            run_budgeted_query(loaded.graph, source, opts, loaded.rows_sorted_by_weight,
+                dijkstra_result.distances);
+        }
+        if (!opts.targets.empty()) {
+            run_one_to_many_query(loaded.graph, source, opts, loaded.rows_sorted_by_weight,
+                dijkstra_result.distances);
+        }
+        if (opts.target && !loaded.coordinates.empty()) {
+            run_astar_query(loaded.graph, loaded.coordinates, source, opts, dijkstra_result.distances);
+        }
+
+        if (opts.distributed > 0) {
+            const std::uint64_t delta = opts.delta.value_or(default_delta(loaded.graph));
+            std::vector<RankStats> rank_stats;
+            RunResult distributed_result = time_algorithm(loaded.graph, source,
+                "Distributed delta-stepping (" + std::to_string(opts.distributed) + " proc)",
+                [&](const Graph& g, int s) {
+                    return distributed_delta_stepping(g, s, opts.distributed, delta, &rank_stats);
+                },
+                runs);
+            verify_results(dijkstra_result.distances, distributed_result.distances);
+            std::cout << "  delta=" << delta << ", results match Dijkstra" << std::endl;
+            print_rank_stats(rank_stats);
+        }
+
+        if (!opts.scaling.empty()) {
+            run_scaling(loaded.graph, source, opts.scaling, opts.scaling_threads, runs,
+                dijkstra_result.distances);
+        }
+        if (opts.batch > 0) {
+            run_batch_report(loaded.graph, source, opts.batch, opts.batch_bound, runs);
+        }
+
+        if (opts.nearest > 0) {
+            print_nearest(loaded.graph, source, opts.nearest);
+        }
+        if (loaded.memory_plan) {
+            print_peak_memory(*loaded.memory_plan);
+        }
     }
     catch (const std::exception& ex) {
         std::cerr << "Error: " << ex.what() << std::endl;